@@ -10,6 +10,7 @@ import beethoven.Platforms.FPGA.Xilinx.AWS.AWSF2Platform
 import beethoven.Platforms.FPGA.Xilinx.AWS.DMAHelper
 import beethoven.Platforms.FPGA.Xilinx.AWS.DMAHelperConfig
 import beethoven.Generation.CppGeneration
+import perf._
 
 class FirFilterSolution(window: Int)(implicit p: Parameters) extends AcceleratorCore {
     CppGeneration.addPreprocessorDefinition("ACCEL_WINDOW_SIZE", window)
@@ -31,21 +32,51 @@ class FirFilterSolution(window: Int)(implicit p: Parameters) extends Accelerator
     reader_in.requestChannel.bits := DontCare
     writer_out.requestChannel.bits := DontCare
 
+    // same as do_filter, but keeps the window history from the previous
+    // command so a long stream can be filtered in fixed-size chunks
+    val continue_cmd = BeethovenIO(new AccelCommand("continue_filter") {
+        val input_addr = Address()
+        val output_addr = Address()
+        val n_elems = UInt(32.W)
+    }, new EmptyAccelResponse)
+
+    // stream the whole tap vector from memory in one command instead of one
+    // set_taps per tap. Word i of the buffer becomes taps(i).
+    val tap_load = BeethovenIO(new AccelCommand("load_taps") {
+        val tap_addr = Address()
+    }, new EmptyAccelResponse)
+    val reader_taps = getReaderModule("tap_stream")
+    val t_IDLE :: t_LOADING :: t_FINISH :: Nil = Enum(3)
+    val tap_state = RegInit(t_IDLE)
+
     val ele_ctr, eles_expected = Reg(UInt(32.W))
+    val is_continue = Reg(Bool())
     val s_IDLE :: s_COMPUTING :: s_FINISH :: Nil = Enum(3)
     val state = RegInit(s_IDLE)
     start_cmd.req.ready := false.B
+    continue_cmd.req.ready := false.B
+    start_cmd.resp.valid := false.B
+    continue_cmd.resp.valid := false.B
     when (state === s_IDLE) {
-        start_cmd.req.ready := reader_in.requestChannel.ready && writer_out.requestChannel.ready
-        when (start_cmd.req.fire) {
-            reader_in.requestChannel.bits.addr := start_cmd.req.bits.input_addr
-            writer_out.requestChannel.bits.addr := start_cmd.req.bits.output_addr
-            reader_in.requestChannel.bits.len := start_cmd.req.bits.n_elems * 4.U
-            writer_out.requestChannel.bits.len := start_cmd.req.bits.n_elems * 4.U
+        // taps can't change underneath a running filter (and vice-versa)
+        val channels_ready = reader_in.requestChannel.ready && writer_out.requestChannel.ready &&
+            tap_state === t_IDLE
+        // do_filter wins if both arrive in the same cycle
+        start_cmd.req.ready := channels_ready
+        continue_cmd.req.ready := channels_ready && !start_cmd.req.valid
+        when (start_cmd.req.fire || continue_cmd.req.fire) {
+            val input_addr = Mux(start_cmd.req.fire, start_cmd.req.bits.input_addr, continue_cmd.req.bits.input_addr)
+            val output_addr = Mux(start_cmd.req.fire, start_cmd.req.bits.output_addr, continue_cmd.req.bits.output_addr)
+            val n_elems = Mux(start_cmd.req.fire, start_cmd.req.bits.n_elems, continue_cmd.req.bits.n_elems)
+            reader_in.requestChannel.bits.addr := input_addr
+            writer_out.requestChannel.bits.addr := output_addr
+            reader_in.requestChannel.bits.len := n_elems * 4.U
+            writer_out.requestChannel.bits.len := n_elems * 4.U
             reader_in.requestChannel.valid := true.B
             writer_out.requestChannel.valid := true.B
             ele_ctr := 0.U
-            eles_expected := start_cmd.req.bits.n_elems
+            eles_expected := n_elems
+            is_continue := continue_cmd.req.fire
             state := s_COMPUTING
         }
     }.elsewhen(state === s_COMPUTING) {
@@ -54,16 +85,46 @@ class FirFilterSolution(window: Int)(implicit p: Parameters) extends Accelerator
         }
 
     }.elsewhen(state === s_FINISH) {
-        start_cmd.resp.valid := true.B
-        when (start_cmd.resp.fire) {
+        start_cmd.resp.valid := !is_continue
+        continue_cmd.resp.valid := is_continue
+        when (start_cmd.resp.fire || continue_cmd.resp.fire) {
             state := s_IDLE
         }
     }
     val taps = Reg(Vec(window, UInt(32.W)))
-    tap_set.req.ready := true.B
+    // like load_taps, set_taps waits for the running filter to finish
+    tap_set.req.ready := tap_state === t_IDLE && state === s_IDLE &&
+        !start_cmd.req.valid && !continue_cmd.req.valid
     when (tap_set.req.fire) {
         taps(tap_set.req.bits.tap_idx) := tap_set.req.bits.tap_value
     }
+
+    val tap_load_ctr = Reg(UInt(log2Up(window + 1).W))
+    tap_load.req.ready := tap_state === t_IDLE && state === s_IDLE && reader_taps.requestChannel.ready &&
+        !start_cmd.req.valid && !continue_cmd.req.valid
+    tap_load.resp.valid := tap_state === t_FINISH
+    reader_taps.requestChannel.valid := tap_load.req.fire
+    reader_taps.requestChannel.bits.addr := tap_load.req.bits.tap_addr
+    reader_taps.requestChannel.bits.len := (window * 4).U
+    reader_taps.dataChannel.data.ready := tap_state === t_LOADING
+    when (tap_state === t_IDLE) {
+        when (tap_load.req.fire) {
+            tap_load_ctr := 0.U
+            tap_state := t_LOADING
+        }
+    }.elsewhen(tap_state === t_LOADING) {
+        when (reader_taps.dataChannel.data.fire) {
+            taps(tap_load_ctr) := reader_taps.dataChannel.data.bits
+            tap_load_ctr := tap_load_ctr + 1.U
+            when (tap_load_ctr === (window - 1).U) {
+                tap_state := t_FINISH
+            }
+        }
+    }.otherwise {
+        when (tap_load.resp.fire) {
+            tap_state := t_IDLE
+        }
+    }
     val window_reg = Reg(Vec(window-1, UInt(32.W)))
     val full_window = Seq(reader_in.dataChannel.data.bits) ++ window_reg
     when (start_cmd.req.fire) {
@@ -87,21 +148,45 @@ class FirFilterSolution(window: Int)(implicit p: Parameters) extends Accelerator
     when (reader_in.dataChannel.data.fire) {
         ele_ctr := ele_ctr + 1.U
     }
+
+    // performance counters, readers in order: input_stream, tap_stream
+    val read_counters = BeethovenIO(new ReadCountersCmd, new CounterValueResponse)
+    val reset_counters = BeethovenIO(new ResetCountersCmd, EmptyAccelResponse())
+    val counters = Module(new PerfCounterBank(2))
+    counters.io.busy := state =/= s_IDLE || tap_state =/= t_IDLE
+    counters.io.reader_stall(0) := state === s_COMPUTING && ele_ctr =/= eles_expected &&
+        !reader_in.dataChannel.data.valid
+    counters.io.reader_stall(1) := tap_state === t_LOADING && !reader_taps.dataChannel.data.valid
+    counters.io.writer_stall := writer_out.dataChannel.data.valid && !writer_out.dataChannel.data.ready
+    counters.io.command_done := start_cmd.resp.fire || continue_cmd.resp.fire || tap_load.resp.fire
+    counters.io.clear := reset_counters.req.fire
+    counters.io.sel := read_counters.req.bits.counter_id
+
+    read_counters.req.ready := read_counters.resp.ready
+    read_counters.resp.valid := read_counters.req.valid
+    read_counters.resp.bits.value := counters.io.value
+    reset_counters.req.ready := reset_counters.resp.ready
+    reset_counters.resp.valid := reset_counters.req.valid
 }
 
-class FirFilterSolutionConfig(windowSize: Int) extends AcceleratorConfig(
+class FirFilterSolutionConfig(windowSize: Int, nCores: Int = 3) extends AcceleratorConfig(
     List(AcceleratorSystemConfig(
-        nCores = 3,
+        nCores = nCores,
         name = "FIR",
         moduleConstructor = ModuleBuilder(p => new FirFilterSolution(windowSize)(p)),
         memoryChannelConfig = List(
             ReadChannelConfig("input_stream", dataBytes = 4),
+            ReadChannelConfig("tap_stream", dataBytes = 4),
             WriteChannelConfig("output_stream", dataBytes = 4)
         )), new DMAHelperConfig()
         ))
 
-object FirFilterSolutionBuild extends BeethovenBuild(
-    new FirFilterSolutionConfig(4),
+object FirFilterSolutionBuild extends BeethovenBuild({
+        val nCores = 3
+        // the host shards long signals over every FIR core
+        CppGeneration.addPreprocessorDefinition("FIR_N_CORES", nCores)
+        new FirFilterSolutionConfig(4, nCores)
+    },
     platform = new AWSF2Platform(),
     buildMode =  BuildMode.Synthesis
 )
\ No newline at end of file
@@ -0,0 +1,57 @@
+package perf
+
+import chisel3._
+import chisel3.util._
+import beethoven._
+
+// Commands shared by every core that exposes performance counters. They use
+// fixed widths so Verilog blackbox cores can declare the same interface.
+class ReadCountersCmd extends AccelCommand("read_counters") {
+  val counter_id = UInt(8.W)
+}
+
+class ResetCountersCmd extends AccelCommand("reset_counters") {}
+
+class CounterValueResponse extends AccelResponse("counter_value") {
+  val value = UInt(64.W)
+}
+
+object PerfCounters {
+  // counter layout, mirrored in src/test/c/common/perf_counters.h
+  val TOTAL_CYCLES = 0
+  val BUSY_CYCLES = 1
+  val WRITER_STALL_CYCLES = 2
+  val COMMANDS_COMPLETED = 3
+  val FIRST_READER_STALL = 4
+
+  def nCounters(nReaders: Int): Int = FIRST_READER_STALL + nReaders
+}
+
+/**
+ * 64-bit event counters: one increment strobe per counter, a synchronous
+ * clear, and a single read port selected by `sel`. Counter 0 counts every
+ * cycle since the last clear so the host can turn the others into ratios.
+ */
+class PerfCounterBank(nReaders: Int) extends Module {
+  val n = PerfCounters.nCounters(nReaders)
+  val io = IO(new Bundle {
+    val busy = Input(Bool())
+    val reader_stall = Input(Vec(nReaders, Bool()))
+    val writer_stall = Input(Bool())
+    val command_done = Input(Bool())
+
+    val clear = Input(Bool())
+    val sel = Input(UInt(8.W))
+    val value = Output(UInt(64.W))
+  })
+  val counters = RegInit(VecInit(Seq.fill(n)(0.U(64.W))))
+  val incs = Seq(true.B, io.busy, io.writer_stall, io.command_done) ++ io.reader_stall
+  counters.zip(incs).foreach { case (ctr, inc) =>
+    when(io.clear) {
+      ctr := 0.U
+    }.elsewhen(inc) {
+      ctr := ctr + 1.U
+    }
+  }
+  io.value := Mux(io.sel < n.U, counters(io.sel), 0.U)
+}
@@ -4,12 +4,26 @@ import chisel3.util.isPow2
 
 object Constants {
   val systolic_array_dim = 8
+  // number of SystolicArrayCores instantiated, host GEMM tiles are spread across all of them
+  val n_cores = 1
 
+  // Element width of the PEs and memory channels: 16 for the original
+  // datapath, 8 for int8 (twice the MACs per channel beat, half the traffic).
+  // Elements are sign-magnitude fixed point, 1 sign bit and the rest split
+  // evenly between integer and fraction bits: 16 -> 1.7.8, 8 -> 1.3.4.
+  // The host code picks the format up from the exported DATA_WIDTH_BYTES,
+  // FRAC_BITS and INT_BITS.
   val data_width_bits = 16
   val data_width_bytes = data_width_bits / 8
-  val int_bits = 7
-  val frac_bits = 8
+  val frac_bits = data_width_bits / 2
+  val int_bits = data_width_bits - frac_bits - 1
+
+  // Most input channels a conv command takes: the im2col buffer holds two
+  // kernel positions' worth of pixels (2 x dim x conv_max_channels elements).
+  // Exported as SYSTOLIC_ARRAY_CONV_CHANNELS.
+  val conv_max_channels = 512
   
   require(int_bits + frac_bits + 1 == data_width_bits)
-  require(isPow2(data_width_bits))
-}
\ No newline at end of file
+  require(isPow2(data_width_bits) && data_width_bits >= 8, "elements must be whole power-of-two bytes")
+  require(conv_max_channels % systolic_array_dim == 0)
+}
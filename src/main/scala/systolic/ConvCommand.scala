@@ -0,0 +1,37 @@
+package systolic
+
+import beethoven._
+import chisel3._
+
+// One output tile of a 2D convolution, with the activations generated from
+// the NHWC input instead of a packed panel (see chisel/Im2colStream.scala).
+//
+// The tile covers n_pixels (<= DIM) consecutive output pixels of one image
+// in row-major order, starting at (out_row, out_col) of an output that is
+// out_width pixels wide, and DIM output channels whose weights are packed
+// like a matmul weight panel: kernel_height * kernel_width * channels beats
+// in (ky, kx, c) order. Lanes past n_pixels and taps that fall in the
+// padding stream zeros. channels must be a multiple of DIM and at most
+// SYSTOLIC_ARRAY_CONV_CHANNELS. The tile is written to out_addr like a
+// matmul tile.
+class SystolicArrayConvCmd extends AccelCommand("conv") {
+  val wgt_addr = UInt(64.W)
+  // first element of this image, row-major in_height x in_width x channels
+  val input_addr = UInt(64.W)
+  val out_addr = UInt(64.W)
+  val in_height = UInt(16.W)
+  val in_width = UInt(16.W)
+  val channels = UInt(16.W)
+  val kernel_height = UInt(8.W)
+  val kernel_width = UInt(8.W)
+  val stride_h = UInt(8.W)
+  val stride_w = UInt(8.W)
+  val pad_h = UInt(8.W)
+  val pad_w = UInt(8.W)
+  val dilation_h = UInt(8.W)
+  val dilation_w = UInt(8.W)
+  val out_width = UInt(16.W)
+  val out_row = UInt(16.W)
+  val out_col = UInt(16.W)
+  val n_pixels = UInt(8.W)
+}
@@ -0,0 +1,24 @@
+package systolic
+
+import beethoven._
+import chisel3._
+
+// Commands for splitting a long inner dimension over several commands while
+// the output tile stays in the PE accumulators. Like SystolicArrayCmd they
+// use fixed widths so the Verilog core can declare the same interface.
+
+// Multiply-accumulate inner_dimension beats into the held tile without
+// writing it back. accumulate = 0 starts a new tile, 1 adds onto the tile
+// left by the previous matmul_partial on this core.
+class SystolicArrayPartialCmd extends AccelCommand("matmul_partial") {
+  val wgt_addr = UInt(64.W)
+  val act_addr = UInt(64.W)
+  val inner_dimension = UInt(20.W)
+  val accumulate = Bool()
+}
+
+// Write the held tile to out_addr (same transposed layout as matmul) and
+// leave the accumulators cleared.
+class SystolicArrayFlushCmd extends AccelCommand("flush") {
+  val out_addr = UInt(64.W)
+}
@@ -0,0 +1,22 @@
+package systolic
+
+import beethoven._
+import chisel3._
+
+// A matmul tile against a block-sparse weight panel (see chisel/SliceSkipper.scala).
+//
+// The panel's K slices (beats of DIM weights) that are all zero aren't
+// stored: wgt_addr holds only the n_slices occupied ones, in k order, and
+// occupancy_addr the panel's bitmap, bit k % 32 of 32-bit word k / 32 set
+// when slice k is stored. act_addr is a dense activation panel of
+// inner_dimension beats; only the beats of occupied slices are read. The
+// tile is written to out_addr like matmul, bit-exact with the dense product.
+// n_slices must be at least 1.
+class SystolicArraySparseCmd extends AccelCommand("matmul_sparse") {
+  val wgt_addr = UInt(64.W)
+  val act_addr = UInt(64.W)
+  val out_addr = UInt(64.W)
+  val occupancy_addr = UInt(64.W)
+  val inner_dimension = UInt(20.W)
+  val n_slices = UInt(20.W)
+}
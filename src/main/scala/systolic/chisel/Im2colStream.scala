@@ -0,0 +1,278 @@
+package systolic.chisel
+
+import chisel3._
+import chisel3.util._
+import systolic.Constants._
+import systolic.SystolicArrayConvCmd
+
+// Conv tile geometry, the fields of SystolicArrayConvCmd that shape the stream
+class Im2colTile extends Bundle {
+  val input_addr = UInt(64.W)
+  val in_height = UInt(16.W)
+  val in_width = UInt(16.W)
+  val channels = UInt(16.W)
+  val kernel_height = UInt(8.W)
+  val kernel_width = UInt(8.W)
+  val stride_h = UInt(8.W)
+  val stride_w = UInt(8.W)
+  val pad_h = UInt(8.W)
+  val pad_w = UInt(8.W)
+  val dilation_h = UInt(8.W)
+  val dilation_w = UInt(8.W)
+  val out_width = UInt(16.W)
+  val out_row = UInt(16.W)
+  val out_col = UInt(16.W)
+  val n_pixels = UInt(8.W)
+}
+
+object Im2colTile {
+  def apply(cmd: SystolicArrayConvCmd): Im2colTile = {
+    val t = Wire(new Im2colTile)
+    t.input_addr := cmd.input_addr
+    t.in_height := cmd.in_height
+    t.in_width := cmd.in_width
+    t.channels := cmd.channels
+    t.kernel_height := cmd.kernel_height
+    t.kernel_width := cmd.kernel_width
+    t.stride_h := cmd.stride_h
+    t.stride_w := cmd.stride_w
+    t.pad_h := cmd.pad_h
+    t.pad_w := cmd.pad_w
+    t.dilation_h := cmd.dilation_h
+    t.dilation_w := cmd.dilation_w
+    t.out_width := cmd.out_width
+    t.out_row := cmd.out_row
+    t.out_col := cmd.out_col
+    t.n_pixels := cmd.n_pixels
+    t
+  }
+}
+
+// one activations reader request
+class ActivationRead extends Bundle {
+  val addr = UInt(64.W)
+  val len = UInt(32.W)
+}
+
+/**
+ * Generates the activation beats of a conv tile from an NHWC image: beat
+ * (ky * kernel_width + kx) * channels + c holds, in lane i, input channel c
+ * of the tap (ky, kx) under output pixel i of the tile, or zero for padding
+ * and for lanes past n_pixels. That's the tile's im2col panel, which never
+ * exists in memory.
+ *
+ * For each kernel position the DIM lanes are walked one per cycle. Lanes
+ * that hit the image and share an output row form a run whose taps are
+ * stride_w pixels apart in one input row, so the run is fetched as a single
+ * contiguous read of whole pixels (channels elements each) and the pixels
+ * between taps are dropped. Pixel data lands in a per-lane buffer, which is
+ * read back a channel at a time across all lanes. The buffer has two halves
+ * so one kernel position is fetched while the previous one streams out.
+ */
+//noinspection TypeAnnotation,ScalaWeakerAccess
+class Im2colStream(dim: Int, maxChannels: Int) extends Module {
+  require(isPow2(dim), "im2col lanes must be a power of two")
+  require(maxChannels % dim == 0 && maxChannels >= 2 * dim,
+    "im2col channel capacity must be a multiple of the array size, at least twice it")
+  val beat_bits = dim * data_width_bits
+  val beat_bytes = dim * data_width_bytes
+  val io = IO(new Bundle {
+    // latched on fire, then all kernel_height * kernel_width * channels beats follow
+    val start = Flipped(Decoupled(new Im2colTile))
+    val req = Decoupled(new ActivationRead)
+    val data_in = Flipped(Decoupled(UInt(beat_bits.W)))
+    val data_out = Decoupled(UInt(beat_bits.W))
+  })
+
+  val tile = Reg(new Im2colTile)
+  val busy = RegInit(false.B)
+  io.start.ready := !busy
+
+  val words_per_pixel = tile.channels >> log2Ceil(dim)
+  val n_positions = tile.kernel_height * tile.kernel_width
+  val depth = maxChannels / dim
+  // mems(i) holds lane i: pixel words of half h at [h * depth, (h + 1) * depth)
+  val mems = Seq.fill(dim)(Mem(2 * depth, Vec(dim, UInt(data_width_bits.W))))
+  val half_full = RegInit(VecInit(Seq.fill(2)(false.B)))
+  // lanes that got a pixel, the rest stream zeros
+  val lane_valid = Reg(Vec(2, Vec(dim, Bool())))
+
+  ///////////////////////////////// fill side /////////////////////////////////
+  val f_half = Reg(UInt(1.W))
+  val f_ky = Reg(UInt(8.W))
+  val f_kx = Reg(UInt(8.W))
+  val f_active = RegInit(false.B)
+  val f_done = Reg(Bool())
+
+  // lane walk for the kernel position being fetched
+  val walking = RegInit(false.B)
+  val w_lane = Reg(UInt(log2Up(dim + 1).W))
+  val w_ox = Reg(UInt(16.W))
+  val w_iy = Reg(SInt(28.W))
+  val w_ix = Reg(SInt(28.W))
+
+  // run of in-image lanes in one output row, not yet queued
+  val run_open = RegInit(false.B)
+  val run_lane = Reg(UInt(log2Up(dim).W))
+  val run_n = Reg(UInt(log2Up(dim + 1).W))
+  val run_iy = Reg(UInt(16.W))
+  val run_ix = Reg(UInt(16.W))
+
+  class Segment extends Bundle {
+    val lane = UInt(log2Up(dim).W)
+    val n_lanes = UInt(log2Up(dim + 1).W)
+    val iy = UInt(16.W)
+    val ix = UInt(16.W)
+  }
+  val segments = Module(new Queue(new Segment, dim))
+
+  val base_x = (f_kx * tile.dilation_w).zext - tile.pad_w.zext
+  when(busy && !f_done && !f_active && !half_full(f_half)) {
+    f_active := true.B
+    walking := true.B
+    w_lane := 0.U
+    w_ox := tile.out_col
+    w_iy := (tile.out_row * tile.stride_h).zext + (f_ky * tile.dilation_h).zext - tile.pad_h.zext
+    w_ix := (tile.out_col * tile.stride_w).zext + base_x
+    lane_valid(f_half).foreach(_ := false.B)
+  }
+
+  val in_image = w_lane < tile.n_pixels &&
+    w_iy >= 0.S && w_iy < tile.in_height.zext && w_ix >= 0.S && w_ix < tile.in_width.zext
+  val row_ends = w_ox === tile.out_width - 1.U || w_lane === (dim - 1).U
+  // a run closes at an out-of-image lane, or including this lane at the end of an output row
+  val close_before = run_open && !in_image
+  val close_with = in_image && row_ends
+  segments.io.enq.valid := walking && (close_before || close_with)
+  segments.io.enq.bits.lane := Mux(run_open, run_lane, w_lane)
+  segments.io.enq.bits.n_lanes := Mux(in_image, Mux(run_open, run_n + 1.U, 1.U), run_n)
+  segments.io.enq.bits.iy := Mux(run_open, run_iy, w_iy.asUInt(15, 0))
+  segments.io.enq.bits.ix := Mux(run_open, run_ix, w_ix.asUInt(15, 0))
+
+  when(walking && (segments.io.enq.ready || !segments.io.enq.valid)) {
+    when(close_with || close_before) {
+      run_open := false.B
+    }.elsewhen(in_image) {
+      when(!run_open) {
+        run_lane := w_lane
+        run_iy := w_iy.asUInt(15, 0)
+        run_ix := w_ix.asUInt(15, 0)
+      }
+      run_open := true.B
+      run_n := Mux(run_open, run_n + 1.U, 1.U)
+    }
+    w_lane := w_lane + 1.U
+    when(w_ox === tile.out_width - 1.U) {
+      w_ox := 0.U
+      w_iy := w_iy + tile.stride_h.zext
+      w_ix := base_x
+    }.otherwise {
+      w_ox := w_ox + 1.U
+      w_ix := w_ix + tile.stride_w.zext
+    }
+    when(w_lane === (dim - 1).U) {
+      walking := false.B
+    }
+  }
+
+  // one read per run: the first tap's pixel through the last tap's pixel
+  val head = segments.io.deq.bits
+  val requested = RegInit(false.B)
+  val span = (head.n_lanes - 1.U) * tile.stride_w + 1.U
+  val pixel = head.iy * tile.in_width + head.ix
+  io.req.valid := segments.io.deq.valid && !requested
+  io.req.bits.addr := tile.input_addr + ((pixel * tile.channels) << log2Ceil(data_width_bytes))
+  io.req.bits.len := (span * words_per_pixel) * beat_bytes.U
+
+  val rx_word = Reg(UInt(16.W))
+  val rx_phase = Reg(UInt(8.W))
+  val rx_lane = Reg(UInt(log2Up(dim).W))
+  val rx_left = Reg(UInt(32.W))
+  when(io.req.fire) {
+    requested := true.B
+    rx_word := 0.U
+    rx_phase := 0.U
+    rx_lane := head.lane
+    rx_left := span * words_per_pixel
+  }
+  io.data_in.ready := requested
+  segments.io.deq.ready := io.data_in.fire && rx_left === 1.U
+  when(io.data_in.fire) {
+    // pixels between taps (rx_phase != 0) are dropped
+    when(rx_phase === 0.U) {
+      for (i <- 0 until dim) {
+        when(rx_lane === i.U) {
+          mems(i).write(Cat(f_half, rx_word(log2Ceil(depth) - 1, 0)),
+            io.data_in.bits.asTypeOf(Vec(dim, UInt(data_width_bits.W))))
+        }
+      }
+      lane_valid(f_half)(rx_lane) := true.B
+    }
+    when(rx_word === words_per_pixel - 1.U) {
+      rx_word := 0.U
+      when(rx_phase === tile.stride_w - 1.U) {
+        rx_phase := 0.U
+        rx_lane := rx_lane + 1.U
+      }.otherwise {
+        rx_phase := rx_phase + 1.U
+      }
+    }.otherwise {
+      rx_word := rx_word + 1.U
+    }
+    rx_left := rx_left - 1.U
+    when(rx_left === 1.U) {
+      requested := false.B
+    }
+  }
+
+  // every run of this kernel position has landed
+  when(f_active && !walking && !run_open && !segments.io.deq.valid && !requested) {
+    f_active := false.B
+    half_full(f_half) := true.B
+    f_half := ~f_half
+    when(f_kx === tile.kernel_width - 1.U) {
+      f_kx := 0.U
+      f_ky := f_ky + 1.U
+      when(f_ky === tile.kernel_height - 1.U) {
+        f_done := true.B
+      }
+    }.otherwise {
+      f_kx := f_kx + 1.U
+    }
+  }
+
+  //////////////////////////////// drain side /////////////////////////////////
+  val d_half = Reg(UInt(1.W))
+  val d_c = Reg(UInt(16.W))
+  val d_position = Reg(UInt(16.W))
+  val d_word = Cat(d_half, (d_c >> log2Ceil(dim))(log2Ceil(depth) - 1, 0))
+  val d_elem = d_c(log2Ceil(dim) - 1, 0)
+  io.data_out.valid := busy && half_full(d_half)
+  io.data_out.bits := Cat((0 until dim).reverse.map { i =>
+    Mux(lane_valid(d_half)(i), mems(i).read(d_word)(d_elem), 0.U(data_width_bits.W))
+  })
+  when(io.data_out.fire) {
+    d_c := d_c + 1.U
+    when(d_c === tile.channels - 1.U) {
+      d_c := 0.U
+      half_full(d_half) := false.B
+      d_half := ~d_half
+      d_position := d_position + 1.U
+      when(d_position === n_positions - 1.U) {
+        busy := false.B
+      }
+    }
+  }
+
+  when(io.start.fire) {
+    tile := io.start.bits
+    busy := true.B
+    f_half := 0.U
+    f_ky := 0.U
+    f_kx := 0.U
+    f_done := false.B
+    d_half := 0.U
+    d_c := 0.U
+    d_position := 0.U
+  }
+}
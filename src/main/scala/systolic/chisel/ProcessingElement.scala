@@ -3,12 +3,29 @@ import chisel3._
 import chisel3.util._
 import systolic.Constants._
 
+// Empty K slices skipped before a beat (see SliceSkipper). A skipped slice
+// would have been a zero-product MAC, which isn't a no-op in sign-magnitude:
+// an accumulator with the overflow bit set gets negated. Applying that step
+// z > 0 times is the same as applying it once for odd z and twice for even
+// z, so the count's parity is all a PE needs to stay bit-exact with dense.
+object SliceSkip {
+  val width = 3
+  // any slices skipped, and whether their count is odd
+  def apply(gap: UInt, only: Bool): UInt = Cat(only, gap(0), gap =/= 0.U)
+  def any(tag: UInt): Bool = tag(0)
+  def odd(tag: UInt): Bool = tag(1)
+  // apply the skipped slices without a MAC (the closing beat of a sparse matmul)
+  def only(tag: UInt): Bool = tag(2)
+}
+
 class ProcessingElement extends Module {
   val io = IO(new Bundle {
     val wgt = Input(UInt(data_width_bits.W))
     val wgt_valid = Input(Bool())
     val act = Input(UInt(data_width_bits.W))
     val act_valid = Input(Bool())
+    // SliceSkip tag travelling with act, 0 for dense beats
+    val skip = Input(UInt(SliceSkip.width.W))
 
     val accumulator_shift = Input(UInt(data_width_bits.W))
     val rst_output = Input(Bool())
@@ -19,6 +36,7 @@ class ProcessingElement extends Module {
     val wgt_valid_out = Output(Bool())
     val act_out = Output(UInt(data_width_bits.W))
     val act_valid_out = Output(Bool())
+    val skip_out = Output(UInt(SliceSkip.width.W))
   })
 
   val accumulator = Reg(UInt(data_width_bits.W))
@@ -26,11 +44,13 @@ class ProcessingElement extends Module {
   val wgt_valid_out = Reg(Bool())
   val act_out = Reg(UInt(data_width_bits.W))
   val act_valid_out = Reg(Bool())
+  val skip_out = Reg(UInt(SliceSkip.width.W))
   io.accumulator := accumulator
   io.wgt_out := wgt_out
   io.wgt_valid_out := wgt_valid_out
   io.act_out := act_out
   io.act_valid_out := act_valid_out
+  io.skip_out := skip_out
 
   val wgt_f = io.wgt.tail(1)
   val act_f = io.act.tail(1)
@@ -41,18 +61,29 @@ class ProcessingElement extends Module {
   val product_f = product(frac_bits * 2 + int_bits - 1, frac_bits)
   val product_s = act_s ^ wgt_s;
 
-  val accumulator_f = accumulator.tail(1)
-  val accumulator_s = accumulator.head(1).asBool
+  def mac(accumulator: UInt, product_f: UInt, product_s: Bool): UInt = {
+    val accumulator_f = accumulator.tail(1)
+    val accumulator_s = accumulator.head(1).asBool
 
-  val opp_sign = product_s ^ accumulator_s
-  val adj_product_f = Mux(opp_sign, (~product_f) + 1.U, product_f)
-  val addition = accumulator_f + adj_product_f
+    val opp_sign = product_s ^ accumulator_s
+    val adj_product_f = Mux(opp_sign, (~product_f) + 1.U, product_f)
+    val addition = accumulator_f + adj_product_f
 
-  val oflow = addition.tail(1).head(1).asBool
-  val n_acc_s = accumulator_s ^ oflow
+    val oflow = addition.tail(1).head(1).asBool
+    val n_acc_s = accumulator_s ^ oflow
+
+    val n_acc_f = (addition ^ VecInit(Seq.fill(data_width_bits - 1)(oflow)).asUInt) + oflow
+    Cat(n_acc_s, n_acc_f)
+  }
 
-  val n_acc_f = (addition ^ VecInit(Seq.fill(data_width_bits - 1)(oflow)).asUInt) + oflow
-  val updated_accumulator = Cat(n_acc_s, n_acc_f)
+  // catch up on the zero-product MACs of the slices skipped before this beat
+  val zero_product = 0.U((data_width_bits - 1).W)
+  val zero_once = mac(accumulator, zero_product, false.B)
+  val zero_twice = mac(zero_once, zero_product, false.B)
+  val caught_up = Mux(!SliceSkip.any(io.skip), accumulator,
+    Mux(SliceSkip.odd(io.skip), zero_once, zero_twice))
+  val updated_accumulator = Mux(SliceSkip.only(io.skip), caught_up,
+    mac(caught_up, product_f, product_s))
 
   when(io.rst_output) {
     accumulator := 0.U
@@ -71,6 +102,7 @@ class ProcessingElement extends Module {
   act_valid_out := io.act_valid
   wgt_out := io.wgt
   act_out := io.act
+  skip_out := io.skip
 
 }
 
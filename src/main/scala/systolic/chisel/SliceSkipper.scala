@@ -0,0 +1,128 @@
+package systolic.chisel
+
+import chisel3._
+import chisel3.util._
+import systolic.Constants._
+
+// A run of occupied K slices of a sparse weight panel, or (len = 0) the
+// closing descriptor with the empty slices after the last run
+class SliceRun extends Bundle {
+  val start = UInt(20.W)
+  val len = UInt(20.W)
+  // empty slices skipped right before the run
+  val gap = UInt(20.W)
+}
+
+/**
+ * Walks a weight panel's occupancy bitmap (bit k % 32 of word k / 32 set
+ * when slice k holds a non-zero weight) and turns every run of occupied
+ * slices into one activations read of just those beats, so empty slices are
+ * never fetched. Each run also goes out as a SliceRun for tagging the beats
+ * with the skipped slices, followed by one closing descriptor.
+ *
+ * One run boundary is found per cycle with a priority encoder over the
+ * current word, so the walk takes about two cycles per run plus one per
+ * word, well under the dense inner dimension for the sparsity it's for.
+ */
+//noinspection TypeAnnotation,ScalaWeakerAccess
+class SliceSkipper(dim: Int) extends Module {
+  val beat_bytes = dim * data_width_bytes
+  val io = IO(new Bundle {
+    val start = Flipped(Decoupled(new Bundle {
+      val act_addr = UInt(64.W)
+      val inner_dimension = UInt(20.W)
+    }))
+    val occupancy = Flipped(Decoupled(UInt(32.W)))
+    val req = Decoupled(new ActivationRead)
+    val runs = Decoupled(new SliceRun)
+  })
+
+  val busy = RegInit(false.B)
+  io.start.ready := !busy
+  val act_addr = Reg(UInt(64.W))
+  val inner_dimension = Reg(UInt(20.W))
+
+  // slice of bit 0 of the current word, and the next bit to look at
+  val base = Reg(UInt(20.W))
+  val pos = Reg(UInt(6.W))
+  val word = Reg(UInt(32.W))
+  val have_word = RegInit(false.B)
+  // every word has been walked, only the open run and the closing descriptor are left
+  val closing = Reg(Bool())
+
+  val in_run = Reg(Bool())
+  val run_start = Reg(UInt(20.W))
+  val run_len = Reg(UInt(20.W))
+  val run_gap = Reg(UInt(20.W))
+  val gap = Reg(UInt(20.W))
+
+  io.occupancy.ready := busy && !have_word && !closing
+  when(io.occupancy.fire) {
+    word := io.occupancy.bits
+    have_word := true.B
+    pos := 0.U
+  }
+
+  val left = inner_dimension - base
+  val n_bits = Mux(left >= 32.U, 32.U, left(5, 0))
+  val window = VecInit((0 until 32).map(i => i.U >= pos && i.U < n_bits)).asUInt
+  // the next boundary: a set bit outside a run, a clear bit inside one
+  val target = Mux(in_run, ~word, word) & window
+  val found = target.orR
+  val stop = Mux(found, PriorityEncoder(target), n_bits)
+  val advance = stop - pos
+
+  val walking = busy && have_word
+  val emit_run = (walking && in_run && found) || (busy && closing && in_run)
+  val emit_close = busy && closing && !in_run
+  io.req.valid := emit_run && io.runs.ready
+  io.req.bits.addr := act_addr + run_start * beat_bytes.U
+  io.req.bits.len := io.runs.bits.len * beat_bytes.U
+  io.runs.valid := (emit_run && io.req.ready) || emit_close
+  io.runs.bits.start := run_start
+  io.runs.bits.len := Mux(emit_close, 0.U, Mux(closing, run_len, run_len + advance))
+  io.runs.bits.gap := Mux(emit_close, gap, run_gap)
+
+  when(io.runs.fire) {
+    when(emit_close) {
+      busy := false.B
+    }.otherwise {
+      in_run := false.B
+      gap := 0.U
+      when(!closing) {
+        pos := stop
+      }
+    }
+  }.elsewhen(walking && !emit_run) {
+    when(found) {
+      // a run starts at `stop`
+      in_run := true.B
+      run_start := base + stop
+      run_len := 0.U
+      run_gap := gap + advance
+      pos := stop
+    }.otherwise {
+      when(in_run) {
+        run_len := run_len + advance
+      }.otherwise {
+        gap := gap + advance
+      }
+      have_word := false.B
+      base := base + 32.U
+      when(left <= 32.U) {
+        closing := true.B
+      }
+    }
+  }
+
+  when(io.start.fire) {
+    busy := true.B
+    act_addr := io.start.bits.act_addr
+    inner_dimension := io.start.bits.inner_dimension
+    base := 0.U
+    have_word := false.B
+    closing := false.B
+    in_run := false.B
+    gap := 0.U
+  }
+}
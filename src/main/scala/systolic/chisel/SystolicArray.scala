@@ -12,6 +12,8 @@ class SystolicArray(implicit p: Parameters) extends Module {
     val act_in = Input(UInt((systolic_array_dim * data_width_bits).W))
     val act_valid = Input(Bool())
     val act_ready = Output(Bool())
+    // SliceSkip tag of the act beat, 0 for dense matmuls
+    val act_skip = Input(UInt(SliceSkip.width.W))
 
     val wgt_in = Input(UInt((systolic_array_dim * data_width_bits).W))
     val wgt_valid = Input(Bool())
@@ -24,6 +26,10 @@ class SystolicArray(implicit p: Parameters) extends Module {
     val ctrl_start_matmul = Input(Bool())
     val ctrl_start_ready = Output(Bool())
     val ctrl_inner_dimension = Input(UInt(20.W))
+    // keep the accumulators from the previous command instead of clearing them
+    val ctrl_accumulate = Input(Bool())
+    // shift the tile out when done; otherwise it stays in the accumulators
+    val ctrl_write_back = Input(Bool())
   })
   val PEs = Seq.fill(systolic_array_dim, systolic_array_dim)(Module(new ProcessingElement()))
 
@@ -37,6 +43,7 @@ class SystolicArray(implicit p: Parameters) extends Module {
   io.wgt_ready := io.act_valid && io.wgt_valid
   io.act_ready := io.act_valid && io.wgt_valid
 
+  val write_back = Reg(Bool())
   val inner_dimension_ctr = Reg(UInt(20.W))
   val n_inner_dimension_ctr = inner_dimension_ctr - 1.U
   val can_increment_inputs = (io.act_valid && io.wgt_valid) || state =/= s_go
@@ -46,7 +53,7 @@ class SystolicArray(implicit p: Parameters) extends Module {
     (0 until systolic_array_dim).foreach { col =>
       val wgt_for_col = io.wgt_in((col + 1) * data_width_bits - 1, col * data_width_bits)
       val curr = PEs(row)(col)
-      curr.io.rst_output := io.ctrl_start_matmul
+      curr.io.rst_output := io.ctrl_start_matmul && !io.ctrl_accumulate
       curr.io.shift_out := shift_out && io.accumulator_out_ready
       curr.io.wgt := (row match {
         case 0 => ShiftRegEnable(wgt_for_col, col, can_increment_inputs, clock)
@@ -64,6 +71,10 @@ class SystolicArray(implicit p: Parameters) extends Module {
         case 0 => ShiftRegEnable(io.act_valid, row, can_increment_inputs, clock)
         case _ => PEs(row)(col - 1).io.act_valid_out
       })
+      curr.io.skip := (col match {
+        case 0 => ShiftRegEnable(io.act_skip, row, can_increment_inputs, clock)
+        case _ => PEs(row)(col - 1).io.skip_out
+      })
       curr.io.accumulator_shift := (if (col == systolic_array_dim - 1) {
                                       0.U
                                     } else {
@@ -74,8 +85,15 @@ class SystolicArray(implicit p: Parameters) extends Module {
 
   when(state === s_idle) {
     when(io.ctrl_start_matmul) {
-      inner_dimension_ctr := io.ctrl_inner_dimension
-      state := s_go
+      write_back := io.ctrl_write_back
+      when(io.ctrl_inner_dimension === 0.U) {
+        // nothing to multiply, e.g. a flush: go straight to shifting out
+        inner_dimension_ctr := systolic_array_dim.U
+        state := Mux(io.ctrl_write_back, s_shift, s_idle)
+      }.otherwise {
+        inner_dimension_ctr := io.ctrl_inner_dimension
+        state := s_go
+      }
     }
   }.elsewhen(state === s_go) {
     when(can_increment_inputs) {
@@ -90,7 +108,7 @@ class SystolicArray(implicit p: Parameters) extends Module {
     inner_dimension_ctr := n_inner_dimension_ctr
     when(n_inner_dimension_ctr === 0.U) {
       inner_dimension_ctr := systolic_array_dim.U
-      state := s_shift
+      state := Mux(write_back, s_shift, s_idle)
     }
   }.otherwise {
     when(io.accumulator_out_ready) {
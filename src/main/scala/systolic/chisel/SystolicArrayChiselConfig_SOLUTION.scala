@@ -21,6 +21,8 @@ class SystolicArrayChiselConfig_SOLUTION(nCores: Int)
             "activations",
             dataBytes = data_width_bytes * systolic_array_dim
           ),
+          // block-sparse weight panels' occupancy bitmaps, see SliceSkipper
+          ReadChannelConfig("occupancy", dataBytes = 4),
           WriteChannelConfig(
             "vec_out",
             dataBytes = data_width_bytes * systolic_array_dim
@@ -31,7 +33,7 @@ class SystolicArrayChiselConfig_SOLUTION(nCores: Int)
 
 object SystolicArrayConfig_SOLUTION
     extends BeethovenBuild(
-      new SystolicArrayChiselConfig_SOLUTION(1),
+      new SystolicArrayChiselConfig_SOLUTION(n_cores),
       platform = new AWSF2Platform,
       buildMode = BuildMode.Simulation
     )
@@ -61,6 +61,11 @@ class SystolicArrayCore(dim: Int)(implicit p: Parameters) extends AcceleratorCor
 
   sa.io.ctrl_start_matmul /* := ??? */
   sa.io.ctrl_inner_dimension /* := ??? */
+  // every matmul starts from cleared accumulators and writes its tile back
+  sa.io.ctrl_accumulate := false.B
+  sa.io.ctrl_write_back := true.B
+  // dense beats only, nothing skipped
+  sa.io.act_skip := 0.U
 
   when(state === s_idle) {
     // TODO
@@ -7,60 +7,160 @@ import org.chipsalliance.cde.config.Parameters
 import systolic.Constants.data_width_bytes
 import beethoven.Generation.CppGeneration
 import systolic.Constants._
+import systolic.{SystolicArrayConvCmd, SystolicArrayFlushCmd, SystolicArrayPartialCmd, SystolicArraySparseCmd}
+import perf._
 
 class SystolicArrayCore_SOLUTION(dim: Int)(implicit p: Parameters) extends AcceleratorCore {
   val io = BeethovenIO(new SystolicArrayCmd(), EmptyAccelResponse())
+  val partial = BeethovenIO(new SystolicArrayPartialCmd(), EmptyAccelResponse())
+  val flush = BeethovenIO(new SystolicArrayFlushCmd(), EmptyAccelResponse())
+  val conv = BeethovenIO(new SystolicArrayConvCmd(), EmptyAccelResponse())
+  val sparse = BeethovenIO(new SystolicArraySparseCmd(), EmptyAccelResponse())
   val ReaderModuleChannel(weights_req, weights) = getReaderModule("weights")
   val ReaderModuleChannel(activations_req, activations) = getReaderModule("activations")
+  val ReaderModuleChannel(occupancy_req, occupancy) = getReaderModule("occupancy")
   val WriterModuleChannel(output_req, output) = getWriterModule("vec_out")
   CppGeneration.addPreprocessorDefinition(
     Seq(
       ("DATA_WIDTH_BYTES", data_width_bytes),
       ("FRAC_BITS", frac_bits),
       ("INT_BITS", int_bits),
-      ("SYSTOLIC_ARRAY_DIM", systolic_array_dim)
+      ("SYSTOLIC_ARRAY_DIM", systolic_array_dim),
+      ("SYSTOLIC_ARRAY_N_CORES", n_cores),
+      ("SYSTOLIC_ARRAY_CONV_CHANNELS", conv_max_channels),
+      ("SYSTOLIC_ARRAY_SPARSE", 1)
     )
   )
 
+  // matmul reads both operands and writes the tile, matmul_partial only
+  // reads, flush only writes. conv reads weights and writes like matmul, but
+  // its activations come from the im2col unit, which issues its own
+  // activation reads while the command runs. matmul_sparse reads the
+  // stored weight slices in one go and the activation beats of each run of
+  // occupied slices as the slice skipper finds them.
   val cmd_fire = io.req.fire
-  output_req.valid := cmd_fire
-  weights_req.valid := cmd_fire
-  activations_req.valid := cmd_fire
+  val partial_fire = partial.req.fire
+  val flush_fire = flush.req.fire
+  val conv_fire = conv.req.fire
+  val sparse_fire = sparse.req.fire
+  val start_fire = cmd_fire || partial_fire || flush_fire || conv_fire || sparse_fire
+  val conv_inner_dimension =
+    conv.req.bits.kernel_height * conv.req.bits.kernel_width * conv.req.bits.channels
+  val inner_dimension = Mux(partial_fire, partial.req.bits.inner_dimension,
+    Mux(conv_fire, conv_inner_dimension(19, 0), io.req.bits.inner_dimension))
+  // weight beats the command streams; the array gets one more for a sparse
+  // matmul, the closing beat that applies the empty slices after the last run
+  val wgt_beats = Mux(sparse_fire, sparse.req.bits.n_slices, inner_dimension)
+  val conv_mode = RegInit(false.B)
+  val sparse_mode = RegInit(false.B)
+  when(start_fire) {
+    conv_mode := conv_fire
+    sparse_mode := sparse_fire
+  }
+  val im2col = Module(new Im2colStream(dim, conv_max_channels))
+  im2col.io.start.valid := conv_fire
+  im2col.io.start.bits := Im2colTile(conv.req.bits)
+  val skipper = Module(new SliceSkipper(dim))
+  skipper.io.start.valid := sparse_fire
+  skipper.io.start.bits.act_addr := sparse.req.bits.act_addr
+  skipper.io.start.bits.inner_dimension := sparse.req.bits.inner_dimension
+  skipper.io.occupancy <> occupancy.data
+
+  output_req.valid := cmd_fire || flush_fire || conv_fire || sparse_fire
+  weights_req.valid := cmd_fire || partial_fire || conv_fire || sparse_fire
+  occupancy_req.valid := sparse_fire
+  activations_req.valid := Mux(conv_mode, im2col.io.req.valid,
+    Mux(sparse_mode, skipper.io.req.valid, cmd_fire || partial_fire))
+  im2col.io.req.ready := conv_mode && activations_req.ready
+  skipper.io.req.ready := sparse_mode && activations_req.ready
 
   output_req.bits.len := data_width_bytes.U * (dim * dim).U
-  weights_req.bits.len := data_width_bytes.U * dim.U * io.req.bits.inner_dimension
-  activations_req.bits.len := data_width_bytes.U * dim.U * io.req.bits.inner_dimension
+  weights_req.bits.len := data_width_bytes.U * dim.U * wgt_beats
+  occupancy_req.bits.len := ((sparse.req.bits.inner_dimension +& 31.U) >> 5) << 2
+  activations_req.bits.len := Mux(conv_mode, im2col.io.req.bits.len,
+    Mux(sparse_mode, skipper.io.req.bits.len, data_width_bytes.U * dim.U * inner_dimension))
 
-  weights_req.bits.addr := Address(io.req.bits.wgt_addr)
-  activations_req.bits.addr := Address(io.req.bits.act_addr)
-  output_req.bits.addr := Address(io.req.bits.out_addr)
+  weights_req.bits.addr := Address(Mux(partial_fire, partial.req.bits.wgt_addr,
+    Mux(conv_fire, conv.req.bits.wgt_addr,
+      Mux(sparse_fire, sparse.req.bits.wgt_addr, io.req.bits.wgt_addr))))
+  occupancy_req.bits.addr := Address(sparse.req.bits.occupancy_addr)
+  activations_req.bits.addr := Address(Mux(conv_mode, im2col.io.req.bits.addr,
+    Mux(sparse_mode, skipper.io.req.bits.addr,
+      Mux(partial_fire, partial.req.bits.act_addr, io.req.bits.act_addr))))
+  output_req.bits.addr := Address(Mux(flush_fire, flush.req.bits.out_addr,
+    Mux(conv_fire, conv.req.bits.out_addr,
+      Mux(sparse_fire, sparse.req.bits.out_addr, io.req.bits.out_addr))))
 
   val s_idle :: s_go :: s_flush :: s_response :: Nil = Enum(4)
   val state = RegInit(s_idle)
+  // which command is running, so only its response goes out
+  val c_matmul :: c_partial :: c_flush :: c_conv :: c_sparse :: Nil = Enum(5)
+  val running = Reg(UInt(3.W))
 
-  io.req.ready := state === s_idle && weights_req.ready && activations_req.ready && output_req.ready
-  io.resp.valid := state === s_response
+  val operands_ready = weights_req.ready && activations_req.ready
+  // one command per cycle: matmul, then matmul_partial, then flush, then
+  // conv, then matmul_sparse
+  io.req.ready := state === s_idle && operands_ready && output_req.ready
+  partial.req.ready := state === s_idle && operands_ready && !io.req.valid
+  flush.req.ready := state === s_idle && output_req.ready && !io.req.valid && !partial.req.valid
+  conv.req.ready := state === s_idle && weights_req.ready && output_req.ready &&
+    im2col.io.start.ready && !io.req.valid && !partial.req.valid && !flush.req.valid
+  sparse.req.ready := state === s_idle && weights_req.ready && output_req.ready &&
+    occupancy_req.ready && skipper.io.start.ready &&
+    !io.req.valid && !partial.req.valid && !flush.req.valid && !conv.req.valid
+  io.resp.valid := state === s_response && running === c_matmul
+  partial.resp.valid := state === s_response && running === c_partial
+  flush.resp.valid := state === s_response && running === c_flush
+  conv.resp.valid := state === s_response && running === c_conv
+  sparse.resp.valid := state === s_response && running === c_sparse
 
   val sa_idle = Wire(Bool())
   val sa = Module(new SystolicArray())
-  sa.io.act_in := activations.data.bits
-  activations.data.ready := sa.io.act_ready
-  sa.io.act_valid := activations.data.valid
+  im2col.io.data_in.valid := conv_mode && activations.data.valid
+  im2col.io.data_in.bits := activations.data.bits
+  im2col.io.data_out.ready := conv_mode && sa.io.act_ready
+
+  // sparse beats: the first beat of each run is tagged with the empty slices
+  // skipped before it, and the closing descriptor becomes a zero beat that
+  // only applies the trailing ones
+  val runs = Queue(skipper.io.runs, 4)
+  val run_beat = RegInit(0.U(20.W))
+  val closing_beat = runs.bits.len === 0.U
+  runs.ready := sparse_mode && sa.io.act_ready && (closing_beat || run_beat === runs.bits.len - 1.U)
+  when(sparse_mode && sa.io.act_ready && !closing_beat) {
+    run_beat := Mux(runs.ready, 0.U, run_beat + 1.U)
+  }
+  val sparse_act_valid = runs.valid && (closing_beat || activations.data.valid)
+  val sparse_wgt_valid = runs.valid && (closing_beat || weights.data.valid)
 
-  sa.io.wgt_in := weights.data.bits
-  weights.data.ready := sa.io.wgt_ready
-  sa.io.wgt_valid := weights.data.valid
+  activations.data.ready := Mux(conv_mode, im2col.io.data_in.ready,
+    sa.io.act_ready && !(sparse_mode && closing_beat))
+  sa.io.act_in := Mux(conv_mode, im2col.io.data_out.bits,
+    Mux(sparse_mode && closing_beat, 0.U, activations.data.bits))
+  sa.io.act_valid := Mux(conv_mode, im2col.io.data_out.valid,
+    Mux(sparse_mode, sparse_act_valid, activations.data.valid))
+  sa.io.act_skip := Mux(sparse_mode,
+    SliceSkip(Mux(run_beat === 0.U, runs.bits.gap, 0.U), closing_beat), 0.U)
+
+  sa.io.wgt_in := Mux(sparse_mode && closing_beat, 0.U, weights.data.bits)
+  weights.data.ready := sa.io.wgt_ready && !(sparse_mode && closing_beat)
+  sa.io.wgt_valid := Mux(sparse_mode, sparse_wgt_valid, weights.data.valid)
 
   output.data.valid := sa.io.accumulator_out_valid
   sa.io.accumulator_out_ready := output.data.ready
   output.data.bits := sa.io.accumulator_out
 
-  sa.io.ctrl_start_matmul := cmd_fire
-  sa.io.ctrl_inner_dimension := io.req.bits.inner_dimension
+  sa.io.ctrl_start_matmul := start_fire
+  sa.io.ctrl_inner_dimension := Mux(flush_fire, 0.U,
+    Mux(sparse_fire, sparse.req.bits.n_slices + 1.U, inner_dimension))
+  sa.io.ctrl_accumulate := (partial_fire && partial.req.bits.accumulate) || flush_fire
+  sa.io.ctrl_write_back := !partial_fire
   sa_idle := sa.io.ctrl_start_ready
 
   when(state === s_idle) {
-    when(cmd_fire) {
+    when(start_fire) {
+      running := Mux(cmd_fire, c_matmul, Mux(partial_fire, c_partial,
+        Mux(flush_fire, c_flush, Mux(conv_fire, c_conv, c_sparse))))
       state := s_go
     }
   }.elsewhen(state === s_go) {
@@ -72,8 +172,35 @@ class SystolicArrayCore_SOLUTION(dim: Int)(implicit p: Parameters) extends Accel
       state := s_response
     }
   }.elsewhen(state === s_response) {
-    when(io.resp.ready) {
+    when(io.resp.fire || partial.resp.fire || flush.resp.fire || conv.resp.fire || sparse.resp.fire) {
       state := s_idle
     }
   }
+
+  // performance counters, readers in order: weights, activations
+  val read_counters = BeethovenIO(new ReadCountersCmd, new CounterValueResponse)
+  val reset_counters = BeethovenIO(new ResetCountersCmd, EmptyAccelResponse())
+  // operand beats still expected for the running command
+  val beats_left = RegInit(0.U(20.W))
+  when(cmd_fire || partial_fire || conv_fire || sparse_fire) {
+    beats_left := wgt_beats
+  }.elsewhen(weights.data.fire && beats_left =/= 0.U) {
+    beats_left := beats_left - 1.U
+  }
+  val counters = Module(new PerfCounterBank(2))
+  counters.io.busy := state =/= s_idle
+  counters.io.reader_stall(0) := beats_left =/= 0.U && !weights.data.valid
+  // in conv mode, stalls on the im2col stream as the array sees it
+  counters.io.reader_stall(1) := beats_left =/= 0.U && !sa.io.act_valid
+  counters.io.writer_stall := output.data.valid && !output.data.ready
+  counters.io.command_done := io.resp.fire || partial.resp.fire || flush.resp.fire ||
+    conv.resp.fire || sparse.resp.fire
+  counters.io.clear := reset_counters.req.fire
+  counters.io.sel := read_counters.req.bits.counter_id
+
+  read_counters.req.ready := read_counters.resp.ready
+  read_counters.resp.valid := read_counters.req.valid
+  read_counters.resp.bits.value := counters.io.value
+  reset_counters.req.ready := reset_counters.resp.ready
+  reset_counters.resp.valid := reset_counters.req.valid
 }
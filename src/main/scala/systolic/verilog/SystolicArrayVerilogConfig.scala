@@ -8,6 +8,7 @@ import systolic.Constants.data_width_bits
 import systolic.Constants.int_bits
 import systolic.Constants.frac_bits
 import beethoven.Generation.CppGeneration
+import perf._
 
 class SystolicArrayCmd extends AccelCommand("matmul") {
   val wgt_addr = UInt(64.W)
@@ -22,11 +23,17 @@ class SystolicArrayConfig(nCores: Int)
         nCores = nCores,
         name = "SystolicArrayCore",
         moduleConstructor = new BlackboxBuilderCustom(
+          // SystolicArrayCore.v is shared with SystolicArrayConfig_SOLUTION, so
+          // every command its ports expect has to be declared here as well
           Seq(
             BeethovenIOInterface(
               new SystolicArrayCmd,
               EmptyAccelResponse()
-            )
+            ),
+            BeethovenIOInterface(new SystolicArrayPartialCmd, EmptyAccelResponse()),
+            BeethovenIOInterface(new SystolicArrayFlushCmd, EmptyAccelResponse()),
+            BeethovenIOInterface(new ReadCountersCmd, new CounterValueResponse),
+            BeethovenIOInterface(new ResetCountersCmd, EmptyAccelResponse())
           ),
           // This is where Beethoven will generate the AcceleratorCore
           // definition if something is not already there with the correct
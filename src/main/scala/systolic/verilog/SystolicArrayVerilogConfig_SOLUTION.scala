@@ -7,7 +7,9 @@ import systolic.Constants.systolic_array_dim
 import systolic.Constants.data_width_bits
 import systolic.Constants.int_bits
 import systolic.Constants.frac_bits
+import systolic.Constants.n_cores
 import beethoven.Generation.CppGeneration
+import perf._
 
 class SystolicArrayConfig_SOLUTION(nCores: Int)
     extends AcceleratorConfig(
@@ -19,7 +21,11 @@ class SystolicArrayConfig_SOLUTION(nCores: Int)
             BeethovenIOInterface(
               new SystolicArrayCmd,
               EmptyAccelResponse()
-            )
+            ),
+            BeethovenIOInterface(new SystolicArrayPartialCmd, EmptyAccelResponse()),
+            BeethovenIOInterface(new SystolicArrayFlushCmd, EmptyAccelResponse()),
+            BeethovenIOInterface(new ReadCountersCmd, new CounterValueResponse),
+            BeethovenIOInterface(new ResetCountersCmd, EmptyAccelResponse())
           ),
           sourcePath = os.pwd / "src" / "main" / "verilog" / "systolic",
           externalDependencies = {
@@ -64,11 +70,12 @@ object SystolicArrayConfig_SOLUTION
             ("DATA_WIDTH_BYTES", Constants.data_width_bytes),
             ("FRAC_BITS", frac_bits),
             ("INT_BITS", int_bits),
-            ("SYSTOLIC_ARRAY_DIM", systolic_array_dim)
+            ("SYSTOLIC_ARRAY_DIM", systolic_array_dim),
+            ("SYSTOLIC_ARRAY_N_CORES", n_cores)
           )
         )
 
-        new SystolicArrayConfig_SOLUTION(1)
+        new SystolicArrayConfig_SOLUTION(n_cores)
       },
       platform = new AWSF2Platform,
       buildMode = BuildMode.Simulation
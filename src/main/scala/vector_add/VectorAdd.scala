@@ -6,17 +6,21 @@ import chisel3.util._
 import beethoven._
 import beethoven.MemoryStreams._
 
+// adds `lanes` 32-bit elements per beat, element i in bits [32i+31, 32i]
 //noinspection TypeAnnotation, ScalaWeakerAccess
-class VectorAdd extends Module {
+class VectorAdd(lanes: Int = 1) extends Module {
   val io = IO(new Bundle {
-    val vec_a = Flipped(Decoupled(UInt(32.W)))
-    val vec_b = Flipped(Decoupled(UInt(32.W)))
-    val vec_out = Decoupled(UInt(32.W))
+    val vec_a = Flipped(Decoupled(UInt((32 * lanes).W)))
+    val vec_b = Flipped(Decoupled(UInt((32 * lanes).W)))
+    val vec_out = Decoupled(UInt((32 * lanes).W))
   })
   // only consume an element when everyone's ready to move
   val can_consume = io.vec_a.valid && io.vec_b.valid && io.vec_out.ready
   io.vec_out.valid := can_consume
   io.vec_a.ready := can_consume
   io.vec_b.ready := can_consume
-  io.vec_out.bits := io.vec_a.bits + io.vec_b.bits
+  // one adder per lane so carries never cross element boundaries
+  io.vec_out.bits := Cat((0 until lanes).reverse.map { i =>
+    io.vec_a.bits(32 * i + 31, 32 * i) + io.vec_b.bits(32 * i + 31, 32 * i)
+  })
 }
\ No newline at end of file
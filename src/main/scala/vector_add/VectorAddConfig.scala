@@ -5,16 +5,23 @@ import beethoven._
 import beethoven.Platforms.FPGA.Xilinx.AWS.AWSF2Platform
 import beethoven.Platforms.FPGA.Xilinx.AWS.DMAHelperConfig
 import beethoven.Platforms.FPGA.Xilinx.AWS.MemsetHelperConfig
+import beethoven.Generation.CppGeneration
 
-class VectorAddConfig extends AcceleratorConfig(
+// lanes: 32-bit elements added per cycle per core. The wide channels carry one
+// beat of `lanes` elements (64B at 16 lanes); the *_tail channels carry the
+// elements left over when vector_length isn't a multiple of `lanes`.
+class VectorAddConfig(nCores: Int, lanes: Int = 16) extends AcceleratorConfig(
   List(AcceleratorSystemConfig(
-    nCores = 3,
+    nCores = nCores,
     name = "myVectorAdd",
-    moduleConstructor = ModuleBuilder(p => new VectorAddCore()(p)),
+    moduleConstructor = ModuleBuilder(p => new VectorAddCore(lanes)(p)),
     memoryChannelConfig = List(
-      ReadChannelConfig("vec_a", dataBytes = 4),
-      ReadChannelConfig("vec_b", dataBytes = 4),
-      WriteChannelConfig("vec_out", dataBytes = 4)
+      ReadChannelConfig("vec_a", dataBytes = 4 * lanes),
+      ReadChannelConfig("vec_b", dataBytes = 4 * lanes),
+      WriteChannelConfig("vec_out", dataBytes = 4 * lanes),
+      ReadChannelConfig("vec_a_tail", dataBytes = 4),
+      ReadChannelConfig("vec_b_tail", dataBytes = 4),
+      WriteChannelConfig("vec_out_tail", dataBytes = 4)
     )
   ),
 
@@ -27,6 +34,13 @@ class VectorAddConfig extends AcceleratorConfig(
   //////////////////////////////
   ))
 
-object VectorAddConfig extends BeethovenBuild(new VectorAddConfig,
+object VectorAddConfig extends BeethovenBuild({
+    val nCores = 3
+    val lanes = 16
+    // lets host code (e.g., the Python wrapper) spread commands over every core
+    CppGeneration.addPreprocessorDefinition("VECTOR_ADD_N_CORES", nCores)
+    CppGeneration.addPreprocessorDefinition("VECTOR_ADD_LANES", lanes)
+    new VectorAddConfig(nCores, lanes)
+  },
   buildMode = BuildMode.Simulation,
   platform = new AWSF2Platform("beethoven-user0"))
\ No newline at end of file
@@ -6,9 +6,19 @@ import chisel3.util._
 import beethoven._
 import beethoven.common._
 import org.chipsalliance.cde.config.Parameters
+import perf._
 
+/**
+ * Adds `lanes` elements per cycle. The wide vec_a/vec_b/vec_out channels move
+ * whole beats of `lanes` elements; the last (vector_length % lanes) elements,
+ * which don't fill a beat, go through the one-element *_tail channels so we
+ * never read or write past the end of the caller's buffers. Both parts run
+ * concurrently and the command responds once both writers have flushed.
+ */
 //noinspection TypeAnnotation,ScalaWeakerAccess
-class VectorAddCore()(implicit p: Parameters) extends AcceleratorCore {
+class VectorAddCore(lanes: Int = 1)(implicit p: Parameters) extends AcceleratorCore {
+  require(isPow2(lanes), "VectorAdd lane count must be a power of two")
+
   val my_io = BeethovenIO(new AccelCommand("vector_add") {
     val vec_a_addr = Address()
     val vec_b_addr = Address()
@@ -19,11 +29,21 @@ class VectorAddCore()(implicit p: Parameters) extends AcceleratorCore {
   val vec_a_reader = getReaderModule("vec_a")
   val vec_b_reader = getReaderModule("vec_b")
   val vec_out_writer = getWriterModule("vec_out")
+  val vec_a_tail_reader = getReaderModule("vec_a_tail")
+  val vec_b_tail_reader = getReaderModule("vec_b_tail")
+  val vec_out_tail_writer = getWriterModule("vec_out_tail")
 
-  val vec_length_bytes = my_io.req.bits.vector_length * 4.U
+  // split the command into whole beats and the leftover elements
+  val tail_length = my_io.req.bits.vector_length & (lanes - 1).U
+  val bulk_length = my_io.req.bits.vector_length - tail_length
+  val bulk_bytes = bulk_length * 4.U
+  val tail_bytes = tail_length * 4.U
+  val has_bulk = bulk_length =/= 0.U
+  val has_tail = tail_length =/= 0.U
 
-  // from our previously defined module
-  val dut = Module(new VectorAdd())
+  // from our previously defined module, once wide and once for the tail
+  val dut = Module(new VectorAdd(lanes))
+  val dut_tail = Module(new VectorAdd(1))
 
   /**
    * provide sane default values
@@ -31,49 +51,103 @@ class VectorAddCore()(implicit p: Parameters) extends AcceleratorCore {
   my_io.req.ready := false.B
   my_io.resp.valid := false.B
   // .fire is a Chisel-ism for "ready && valid"
-  vec_a_reader.requestChannel.valid := my_io.req.fire
+  // zero-length parts are never requested, their writer stays flushed
+  vec_a_reader.requestChannel.valid := my_io.req.fire && has_bulk
   vec_a_reader.requestChannel.bits.addr := my_io.req.bits.vec_a_addr
-  vec_a_reader.requestChannel.bits.len := vec_length_bytes
+  vec_a_reader.requestChannel.bits.len := bulk_bytes
 
-  vec_b_reader.requestChannel.valid := my_io.req.fire
+  vec_b_reader.requestChannel.valid := my_io.req.fire && has_bulk
   vec_b_reader.requestChannel.bits.addr := my_io.req.bits.vec_b_addr
-  vec_b_reader.requestChannel.bits.len := vec_length_bytes
+  vec_b_reader.requestChannel.bits.len := bulk_bytes
 
-  vec_out_writer.requestChannel.valid := my_io.req.fire
+  vec_out_writer.requestChannel.valid := my_io.req.fire && has_bulk
   vec_out_writer.requestChannel.bits.addr := my_io.req.bits.vec_out_addr
-  vec_out_writer.requestChannel.bits.len := vec_length_bytes
+  vec_out_writer.requestChannel.bits.len := bulk_bytes
+
+  vec_a_tail_reader.requestChannel.valid := my_io.req.fire && has_tail
+  vec_a_tail_reader.requestChannel.bits.addr := my_io.req.bits.vec_a_addr + bulk_bytes
+  vec_a_tail_reader.requestChannel.bits.len := tail_bytes
 
-  vec_a_reader.dataChannel.data.ready := false.B
-  vec_b_reader.dataChannel.data.ready := false.B
-  vec_out_writer.dataChannel.data.valid := false.B
-  vec_out_writer.dataChannel.data.bits := DontCare
+  vec_b_tail_reader.requestChannel.valid := my_io.req.fire && has_tail
+  vec_b_tail_reader.requestChannel.bits.addr := my_io.req.bits.vec_b_addr + bulk_bytes
+  vec_b_tail_reader.requestChannel.bits.len := tail_bytes
+
+  vec_out_tail_writer.requestChannel.valid := my_io.req.fire && has_tail
+  vec_out_tail_writer.requestChannel.bits.addr := my_io.req.bits.vec_out_addr + bulk_bytes
+  vec_out_tail_writer.requestChannel.bits.len := tail_bytes
 
   dut.io.vec_a <> vec_a_reader.dataChannel.data
   dut.io.vec_b <> vec_b_reader.dataChannel.data
   dut.io.vec_out <> vec_out_writer.dataChannel.data
+  dut_tail.io.vec_a <> vec_a_tail_reader.dataChannel.data
+  dut_tail.io.vec_b <> vec_b_tail_reader.dataChannel.data
+  dut_tail.io.vec_out <> vec_out_tail_writer.dataChannel.data
 
   // state machine
   val s_idle :: s_working :: s_finish :: Nil =  Enum(3)
   val state = RegInit(s_idle)
 
+  // which parts the running command is still waiting on
+  val bulk_pending = RegInit(false.B)
+  val tail_pending = RegInit(false.B)
 
   when (state === s_idle) {
     my_io.req.ready := vec_a_reader.requestChannel.ready &&
       vec_b_reader.requestChannel.ready &&
-      vec_out_writer.requestChannel.ready
+      vec_out_writer.requestChannel.ready &&
+      vec_a_tail_reader.requestChannel.ready &&
+      vec_b_tail_reader.requestChannel.ready &&
+      vec_out_tail_writer.requestChannel.ready
     when (my_io.req.fire) {
+      bulk_pending := has_bulk
+      tail_pending := has_tail
       state := s_working
     }
   }.elsewhen(state === s_working) {
     // when the writer has finished writing the final datum,
     // isFlushed will be driven high
     when (vec_out_writer.dataChannel.isFlushed) {
+      bulk_pending := false.B
+    }
+    when (vec_out_tail_writer.dataChannel.isFlushed) {
+      tail_pending := false.B
+    }
+    when ((!bulk_pending || vec_out_writer.dataChannel.isFlushed) &&
+      (!tail_pending || vec_out_tail_writer.dataChannel.isFlushed)) {
       state := s_finish
     }
   }.otherwise {
-    my_io.resp.valid := vec_out_writer.requestChannel.ready
+    my_io.resp.valid := vec_out_writer.requestChannel.ready && vec_out_tail_writer.requestChannel.ready
     when (my_io.resp.fire) {
       state := s_idle
     }
   }
-}
\ No newline at end of file
+
+  // performance counters: stall on a reader = working but neither the wide nor
+  // the tail channel of that operand has data
+  val read_counters = BeethovenIO(new ReadCountersCmd, new CounterValueResponse)
+  val reset_counters = BeethovenIO(new ResetCountersCmd, EmptyAccelResponse())
+  val counters = Module(new PerfCounterBank(2))
+  counters.io.busy := state =/= s_idle
+  counters.io.reader_stall(0) := state === s_working &&
+    !vec_a_reader.dataChannel.data.valid && !vec_a_tail_reader.dataChannel.data.valid
+  counters.io.reader_stall(1) := state === s_working &&
+    !vec_b_reader.dataChannel.data.valid && !vec_b_tail_reader.dataChannel.data.valid
+  // VectorAdd only raises vec_out.valid when the writer is ready, so backpressure
+  // shows up as both operands waiting on the writer
+  counters.io.writer_stall :=
+    (vec_a_reader.dataChannel.data.valid && vec_b_reader.dataChannel.data.valid &&
+      !vec_out_writer.dataChannel.data.ready) ||
+    (vec_a_tail_reader.dataChannel.data.valid && vec_b_tail_reader.dataChannel.data.valid &&
+      !vec_out_tail_writer.dataChannel.data.ready)
+  counters.io.command_done := my_io.resp.fire
+  counters.io.clear := reset_counters.req.fire
+  counters.io.sel := read_counters.req.bits.counter_id
+
+  // both answer right away, so a request is held until its response can go out
+  read_counters.req.ready := read_counters.resp.ready
+  read_counters.resp.valid := read_counters.req.valid
+  read_counters.resp.bits.value := counters.io.value
+  reset_counters.req.ready := reset_counters.resp.ready
+  reset_counters.resp.valid := reset_counters.req.valid
+}
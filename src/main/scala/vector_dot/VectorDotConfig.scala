@@ -0,0 +1,44 @@
+package vector_dot
+
+
+import beethoven._
+import beethoven.Platforms.FPGA.Xilinx.AWS.AWSF2Platform
+import beethoven.Platforms.FPGA.Xilinx.AWS.DMAHelperConfig
+import beethoven.Platforms.FPGA.Xilinx.AWS.MemsetHelperConfig
+import beethoven.Generation.CppGeneration
+
+// lanes: 32-bit elements folded per cycle per core, with the same wide/tail
+// channel split as VectorAddConfig. There is no write channel, the result
+// comes back in the command's response.
+class VectorDotConfig(nCores: Int, lanes: Int = 16) extends AcceleratorConfig(
+  List(AcceleratorSystemConfig(
+    nCores = nCores,
+    name = "myVectorDot",
+    moduleConstructor = ModuleBuilder(p => new VectorDotCore(lanes)(p)),
+    memoryChannelConfig = List(
+      ReadChannelConfig("vec_a", dataBytes = 4 * lanes),
+      ReadChannelConfig("vec_b", dataBytes = 4 * lanes),
+      ReadChannelConfig("vec_a_tail", dataBytes = 4),
+      ReadChannelConfig("vec_b_tail", dataBytes = 4)
+    )
+  ),
+
+  //////////////////////////////
+  // DO NOT REMOVE OR CHANGE THESE
+  // During the transition from AWS F1 -> F2 instances, some of the AWS infra
+  // is lagging behind, requiring these work-arounds. These are not needed for
+  // simulation, ASIC, or Kria FPGA targets
+  new DMAHelperConfig, new MemsetHelperConfig(4)
+  //////////////////////////////
+  ))
+
+object VectorDotConfig extends BeethovenBuild({
+    val nCores = 3
+    val lanes = 16
+    // the host library splits one reduction over every core
+    CppGeneration.addPreprocessorDefinition("VECTOR_DOT_N_CORES", nCores)
+    CppGeneration.addPreprocessorDefinition("VECTOR_DOT_LANES", lanes)
+    new VectorDotConfig(nCores, lanes)
+  },
+  buildMode = BuildMode.Simulation,
+  platform = new AWSF2Platform("beethoven-user0"))
@@ -0,0 +1,142 @@
+package vector_dot
+
+import chisel3._
+import chisel3.util._
+import beethoven._
+import beethoven.common._
+import org.chipsalliance.cde.config.Parameters
+import perf._
+
+class ReduceResponse extends AccelResponse("reduce_result") {
+  // two's complement, a MIN/MAX of an empty vector is the op's identity
+  val value = UInt(64.W)
+}
+
+/**
+ * Streams one or two vectors of signed 32-bit elements and answers with a
+ * single 64-bit reduction (see ReduceOp) in the response instead of writing
+ * anything back. Reader setup follows VectorAddCore: whole beats of `lanes`
+ * elements on vec_a/vec_b, the last (vector_length % lanes) elements on the
+ * *_tail channels. Each part has its own accumulator and the two are
+ * combined for the response. vec_b is only read for DOT.
+ */
+//noinspection TypeAnnotation,ScalaWeakerAccess
+class VectorDotCore(lanes: Int = 1)(implicit p: Parameters) extends AcceleratorCore {
+  require(isPow2(lanes), "VectorDot lane count must be a power of two")
+
+  val my_io = BeethovenIO(new AccelCommand("reduce") {
+    val op = UInt(ReduceOp.width.W)
+    val vec_a_addr = Address()
+    val vec_b_addr = Address()
+    val vector_length = UInt(32.W)
+  }, new ReduceResponse)
+
+  val vec_a_reader = getReaderModule("vec_a")
+  val vec_b_reader = getReaderModule("vec_b")
+  val vec_a_tail_reader = getReaderModule("vec_a_tail")
+  val vec_b_tail_reader = getReaderModule("vec_b_tail")
+
+  val tail_length = my_io.req.bits.vector_length & (lanes - 1).U
+  val bulk_length = my_io.req.bits.vector_length - tail_length
+  val bulk_bytes = bulk_length * 4.U
+  val tail_bytes = tail_length * 4.U
+  val has_bulk = bulk_length =/= 0.U
+  val has_tail = tail_length =/= 0.U
+  val req_uses_b = my_io.req.bits.op === ReduceOp.DOT.U
+
+  val dut = Module(new VectorReduce(lanes))
+  val dut_tail = Module(new VectorReduce(1))
+
+  my_io.req.ready := false.B
+  my_io.resp.valid := false.B
+
+  vec_a_reader.requestChannel.valid := my_io.req.fire && has_bulk
+  vec_a_reader.requestChannel.bits.addr := my_io.req.bits.vec_a_addr
+  vec_a_reader.requestChannel.bits.len := bulk_bytes
+
+  vec_b_reader.requestChannel.valid := my_io.req.fire && has_bulk && req_uses_b
+  vec_b_reader.requestChannel.bits.addr := my_io.req.bits.vec_b_addr
+  vec_b_reader.requestChannel.bits.len := bulk_bytes
+
+  vec_a_tail_reader.requestChannel.valid := my_io.req.fire && has_tail
+  vec_a_tail_reader.requestChannel.bits.addr := my_io.req.bits.vec_a_addr + bulk_bytes
+  vec_a_tail_reader.requestChannel.bits.len := tail_bytes
+
+  vec_b_tail_reader.requestChannel.valid := my_io.req.fire && has_tail && req_uses_b
+  vec_b_tail_reader.requestChannel.bits.addr := my_io.req.bits.vec_b_addr + bulk_bytes
+  vec_b_tail_reader.requestChannel.bits.len := tail_bytes
+
+  // the op is latched with the command, the accumulators are cleared with it
+  val op = Reg(UInt(ReduceOp.width.W))
+  val current_op = Mux(my_io.req.fire, my_io.req.bits.op, op)
+  for (d <- Seq(dut, dut_tail)) {
+    d.io.op := current_op
+    d.io.clear := my_io.req.fire
+  }
+  dut.io.vec_a <> vec_a_reader.dataChannel.data
+  dut.io.vec_b <> vec_b_reader.dataChannel.data
+  dut_tail.io.vec_a <> vec_a_tail_reader.dataChannel.data
+  dut_tail.io.vec_b <> vec_b_tail_reader.dataChannel.data
+
+  val s_idle :: s_working :: s_finish :: Nil = Enum(3)
+  val state = RegInit(s_idle)
+
+  // beats (bulk) and elements (tail) still to be folded in
+  val bulk_left = Reg(UInt(32.W))
+  val tail_left = Reg(UInt(32.W))
+
+  when(state === s_idle) {
+    my_io.req.ready := vec_a_reader.requestChannel.ready &&
+      vec_b_reader.requestChannel.ready &&
+      vec_a_tail_reader.requestChannel.ready &&
+      vec_b_tail_reader.requestChannel.ready
+    when(my_io.req.fire) {
+      op := my_io.req.bits.op
+      bulk_left := bulk_length >> log2Ceil(lanes)
+      tail_left := tail_length
+      state := s_working
+    }
+  }.elsewhen(state === s_working) {
+    val bulk_step = dut.io.vec_a.fire
+    val tail_step = dut_tail.io.vec_a.fire
+    when(bulk_step) {
+      bulk_left := bulk_left - 1.U
+    }
+    when(tail_step) {
+      tail_left := tail_left - 1.U
+    }
+    val bulk_done = bulk_left === 0.U || (bulk_left === 1.U && bulk_step)
+    val tail_done = tail_left === 0.U || (tail_left === 1.U && tail_step)
+    when(bulk_done && tail_done) {
+      state := s_finish
+    }
+  }.otherwise {
+    my_io.resp.valid := true.B
+    when(my_io.resp.fire) {
+      state := s_idle
+    }
+  }
+  my_io.resp.bits.value := ReduceOp.combine(op, dut.io.result, dut_tail.io.result).asUInt
+
+  // performance counters, readers in order: vec_a, vec_b. Nothing is written,
+  // so there is no writer stall.
+  val read_counters = BeethovenIO(new ReadCountersCmd, new CounterValueResponse)
+  val reset_counters = BeethovenIO(new ResetCountersCmd, EmptyAccelResponse())
+  val counters = Module(new PerfCounterBank(2))
+  val uses_b = op === ReduceOp.DOT.U
+  counters.io.busy := state =/= s_idle
+  counters.io.reader_stall(0) := state === s_working &&
+    !vec_a_reader.dataChannel.data.valid && !vec_a_tail_reader.dataChannel.data.valid
+  counters.io.reader_stall(1) := state === s_working && uses_b &&
+    !vec_b_reader.dataChannel.data.valid && !vec_b_tail_reader.dataChannel.data.valid
+  counters.io.writer_stall := false.B
+  counters.io.command_done := my_io.resp.fire
+  counters.io.clear := reset_counters.req.fire
+  counters.io.sel := read_counters.req.bits.counter_id
+
+  read_counters.req.ready := read_counters.resp.ready
+  read_counters.resp.valid := read_counters.req.valid
+  read_counters.resp.bits.value := counters.io.value
+  reset_counters.req.ready := reset_counters.resp.ready
+  reset_counters.resp.valid := reset_counters.req.valid
+}
@@ -0,0 +1,59 @@
+package vector_dot
+
+import chisel3._
+import chisel3.util._
+
+// op codes of the reduce command, mirrored by vector_dot::op in src/test/c/vector_dot/reduce.h
+object ReduceOp {
+  val DOT = 0     // sum of a[i] * b[i]
+  val SUM = 1     // sum of a[i]
+  val MIN = 2     // smallest a[i]
+  val MAX = 3     // largest a[i]
+  val SQ_NORM = 4 // sum of a[i] * a[i], the host takes the square root
+  val width = 3
+
+  // elements are signed 32-bit, sums and products wrap to 64 bits
+  def identity(op: UInt): SInt =
+    Mux(op === MIN.U, Long.MaxValue.S(64.W), Mux(op === MAX.U, Long.MinValue.S(64.W), 0.S(64.W)))
+
+  def combine(op: UInt, x: SInt, y: SInt): SInt =
+    Mux(op === MIN.U, Mux(x < y, x, y), Mux(op === MAX.U, Mux(x > y, x, y), x +% y))
+}
+
+// folds `lanes` 32-bit elements per beat into a 64-bit accumulator, element i
+// in bits [32i+31, 32i]. vec_b is only consumed for DOT.
+//noinspection TypeAnnotation, ScalaWeakerAccess
+class VectorReduce(lanes: Int = 1) extends Module {
+  val io = IO(new Bundle {
+    val op = Input(UInt(ReduceOp.width.W))
+    // load the op's identity into the accumulator
+    val clear = Input(Bool())
+    val vec_a = Flipped(Decoupled(UInt((32 * lanes).W)))
+    val vec_b = Flipped(Decoupled(UInt((32 * lanes).W)))
+    val result = Output(SInt(64.W))
+  })
+  val uses_b = io.op === ReduceOp.DOT.U
+  val can_consume = io.vec_a.valid && (io.vec_b.valid || !uses_b)
+  io.vec_a.ready := can_consume
+  io.vec_b.ready := can_consume && uses_b
+
+  val a = (0 until lanes).map(i => io.vec_a.bits(32 * i + 31, 32 * i).asSInt)
+  val b = (0 until lanes).map(i => io.vec_b.bits(32 * i + 31, 32 * i).asSInt)
+  // one multiplier per lane: a * b for DOT, a * a for SQ_NORM, a for SUM
+  val terms = a.zip(b).map { case (x, y) =>
+    Mux(io.op === ReduceOp.SUM.U, x.pad(64), x * Mux(uses_b, y, x))
+  }
+  val beat_sum = VecInit(terms).reduceTree(_ +% _)
+  val beat_min = VecInit(a).reduceTree((x, y) => Mux(x < y, x, y))
+  val beat_max = VecInit(a).reduceTree((x, y) => Mux(x > y, x, y))
+  val beat = Mux(io.op === ReduceOp.MIN.U, beat_min.pad(64),
+    Mux(io.op === ReduceOp.MAX.U, beat_max.pad(64), beat_sum))
+
+  val acc = Reg(SInt(64.W))
+  when(io.clear) {
+    acc := ReduceOp.identity(io.op)
+  }.elsewhen(can_consume) {
+    acc := ReduceOp.combine(io.op, acc, beat)
+  }
+  io.result := acc
+}
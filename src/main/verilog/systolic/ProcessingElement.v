@@ -18,7 +18,8 @@ module ProcessingElement #(parameter DATA_WIDTH_BITS, INT_BITS, FRAC_BITS)(
   output reg [(DATA_WIDTH_BITS-1):0] act_out,
   output reg act_valid_out
 );
-/* We're going to use 16-bit fixed-point sign-magnitude arithmetic, 1b sign, 7b integer, 8b fractional */
+/* We're going to use DATA_WIDTH_BITS fixed-point sign-magnitude arithmetic: 1b sign, INT_BITS integer,
+ * FRAC_BITS fractional (16-bit: 1.7.8, 8-bit: 1.3.4, see systolic.Constants) */
 
 // don't feel like subtracting one for verilog [width:0] every time so subtracting one in advance
 localparam DATAW_NOSIGN = (DATA_WIDTH_BITS-1)-1;
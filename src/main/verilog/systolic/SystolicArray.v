@@ -16,10 +16,14 @@ module SystolicArray #(parameter SYSTOLIC_ARRAY_DIM, DATA_WIDTH_BITS, INT_BITS,
 
   input ctrl_start_matmul,
   output ctrl_start_ready,
-  input [19:0] ctrl_inner_dimension
+  input [19:0] ctrl_inner_dimension,
+  // keep the accumulators from the previous command instead of clearing them
+  input ctrl_accumulate,
+  // shift the tile out when done; otherwise it stays in the accumulators
+  input ctrl_write_back
 );
 
-// we're going to split up the 128b bus into 16b payloads
+// we're going to split up the SYSTOLIC_ARRAY_DIM * DATA_WIDTH_BITS bus into DATA_WIDTH_BITS payloads
 wire [(DATA_WIDTH_BITS - 1):0] wgt_shifts   [0:SYSTOLIC_ARRAY_DIM]     [0:(SYSTOLIC_ARRAY_DIM-1)];
 wire [(DATA_WIDTH_BITS - 1):0] act_shifts   [0:(SYSTOLIC_ARRAY_DIM-1)] [0:SYSTOLIC_ARRAY_DIM];
 wire [(DATA_WIDTH_BITS - 1):0] out_shifts   [0:(SYSTOLIC_ARRAY_DIM-1)] [0:SYSTOLIC_ARRAY_DIM];
@@ -48,6 +52,7 @@ assign act_ready = act_valid && wgt_valid;
 
 // count down 
 reg [19:0] inner_dimension_ctr;
+reg write_back;
 wire [19:0] n_inner_dimension_ctr = inner_dimension_ctr - 1;
 wire can_increment_inputs = (act_valid && wgt_valid) || state == `DRAIN;
 
@@ -57,8 +62,15 @@ always @(posedge clk) begin
   end else begin
     if (state == `IDLE) begin
       if (ctrl_start_matmul) begin
-        inner_dimension_ctr <= ctrl_inner_dimension;
-        state <= `GO;
+        write_back <= ctrl_write_back;
+        if (ctrl_inner_dimension == 0) begin
+          // nothing to multiply, e.g. a flush: go straight to shifting out
+          inner_dimension_ctr <= (SYSTOLIC_ARRAY_DIM);
+          state <= ctrl_write_back ? `SHIFT : `IDLE;
+        end else begin
+          inner_dimension_ctr <= ctrl_inner_dimension;
+          state <= `GO;
+        end
       end
     end else if (state == `GO) begin
       if (can_increment_inputs) begin
@@ -73,7 +85,7 @@ always @(posedge clk) begin
       inner_dimension_ctr <= n_inner_dimension_ctr;
       if (n_inner_dimension_ctr == 0) begin
         inner_dimension_ctr <= (SYSTOLIC_ARRAY_DIM);
-        state <= `SHIFT;
+        state <= write_back ? `SHIFT : `IDLE;
       end
     end else begin
       if (accumulator_out_ready) begin
@@ -133,7 +145,7 @@ generate
         .accumulator_shift(out_shifts[i][j+1]),
         .shift_out(shift_out && accumulator_out_ready),
 
-        .rst_output(ctrl_start_matmul),
+        .rst_output(ctrl_start_matmul && !ctrl_accumulate),
 
         .wgt_out(wgt_shifts[i+1][j]),
         .wgt_valid_out(wgt_v_shifts[i+1][j]),
@@ -11,6 +11,29 @@ module SystolicArrayCore #(parameter SYSTOLIC_ARRAY_DIM, DATA_WIDTH_BITS, INT_BI
   input  [63:0]  cmd_matmul_wgt_addr,
   output         resp_matmul_valid,
   input          resp_matmul_ready,
+  input          cmd_matmul_partial_valid,
+  output         cmd_matmul_partial_ready,
+  input  [19:0]  cmd_matmul_partial_inner_dimension,
+  input  [63:0]  cmd_matmul_partial_act_addr,
+  input  [63:0]  cmd_matmul_partial_wgt_addr,
+  input          cmd_matmul_partial_accumulate,
+  output         resp_matmul_partial_valid,
+  input          resp_matmul_partial_ready,
+  input          cmd_flush_valid,
+  output         cmd_flush_ready,
+  input  [63:0]  cmd_flush_out_addr,
+  output         resp_flush_valid,
+  input          resp_flush_ready,
+  input          cmd_read_counters_valid,
+  output         cmd_read_counters_ready,
+  input  [7:0]   cmd_read_counters_counter_id,
+  output         resp_read_counters_valid,
+  input          resp_read_counters_ready,
+  output [63:0]  resp_read_counters_value,
+  input          cmd_reset_counters_valid,
+  output         cmd_reset_counters_ready,
+  output         resp_reset_counters_valid,
+  input          resp_reset_counters_ready,
   output         weights_req_valid,
   input          weights_req_ready,
   output [33:0]  weights_req_len,
@@ -37,29 +60,54 @@ module SystolicArrayCore #(parameter SYSTOLIC_ARRAY_DIM, DATA_WIDTH_BITS, INT_BI
   output [(SYSTOLIC_ARRAY_DIM * DATA_WIDTH_BITS - 1):0] vec_out_data
 );
 
+// matmul reads both operands and writes the tile, matmul_partial only
+// reads, flush only writes
 wire cmd_fire = cmd_matmul_valid && cmd_matmul_ready;
+wire partial_fire = cmd_matmul_partial_valid && cmd_matmul_partial_ready;
+wire flush_fire = cmd_flush_valid && cmd_flush_ready;
+wire start_fire = cmd_fire || partial_fire || flush_fire;
+wire [19:0] inner_dimension = partial_fire ? cmd_matmul_partial_inner_dimension : cmd_matmul_inner_dimension;
 
-assign vec_out_req_valid = cmd_fire;
+assign vec_out_req_valid = cmd_fire || flush_fire;
 assign vec_out_req_len = (SYSTOLIC_ARRAY_DIM * SYSTOLIC_ARRAY_DIM * (DATA_WIDTH_BITS / 8));
-assign vec_out_req_addr_address = cmd_matmul_out_addr;
+assign vec_out_req_addr_address = flush_fire ? cmd_flush_out_addr : cmd_matmul_out_addr;
 
-assign weights_req_valid = cmd_fire;
-assign weights_req_len = (DATA_WIDTH_BITS / 8) * SYSTOLIC_ARRAY_DIM * cmd_matmul_inner_dimension;
-assign weights_req_addr_address = cmd_matmul_wgt_addr;
+assign weights_req_valid = cmd_fire || partial_fire;
+assign weights_req_len = (DATA_WIDTH_BITS / 8) * SYSTOLIC_ARRAY_DIM * inner_dimension;
+assign weights_req_addr_address = partial_fire ? cmd_matmul_partial_wgt_addr : cmd_matmul_wgt_addr;
 
-assign activations_req_valid = cmd_fire;
-assign activations_req_len = (DATA_WIDTH_BITS / 8) * SYSTOLIC_ARRAY_DIM * cmd_matmul_inner_dimension;
-assign activations_req_addr_address = cmd_matmul_act_addr;
+assign activations_req_valid = cmd_fire || partial_fire;
+assign activations_req_len = (DATA_WIDTH_BITS / 8) * SYSTOLIC_ARRAY_DIM * inner_dimension;
+assign activations_req_addr_address = partial_fire ? cmd_matmul_partial_act_addr : cmd_matmul_act_addr;
 
 `define IDLE 0
 `define GO 1
 `define RESPONSE 2
 reg [1:0] state;
+// which command is running, so only its response goes out
+`define RUN_MATMUL 0
+`define RUN_PARTIAL 1
+`define RUN_FLUSH 2
+reg [1:0] running;
+// one command per cycle: matmul, then matmul_partial, then flush
 assign cmd_matmul_ready = state == `IDLE 
         && weights_req_ready 
         && activations_req_ready 
         && vec_out_req_ready;
-assign resp_matmul_valid = state == `RESPONSE;
+assign cmd_matmul_partial_ready = state == `IDLE
+        && weights_req_ready
+        && activations_req_ready
+        && !cmd_matmul_valid;
+assign cmd_flush_ready = state == `IDLE
+        && vec_out_req_ready
+        && !cmd_matmul_valid
+        && !cmd_matmul_partial_valid;
+assign resp_matmul_valid = state == `RESPONSE && running == `RUN_MATMUL;
+assign resp_matmul_partial_valid = state == `RESPONSE && running == `RUN_PARTIAL;
+assign resp_flush_valid = state == `RESPONSE && running == `RUN_FLUSH;
+wire resp_fire = (resp_matmul_valid && resp_matmul_ready)
+        || (resp_matmul_partial_valid && resp_matmul_partial_ready)
+        || (resp_flush_valid && resp_flush_ready);
 
 wire sa_idle;
 
@@ -79,9 +127,11 @@ SystolicArray #(.DATA_WIDTH_BITS(DATA_WIDTH_BITS), .FRAC_BITS(FRAC_BITS), .INT_B
   .accumulator_out_valid(vec_out_data_valid),
   .accumulator_out_ready(vec_out_data_ready),
 
-  .ctrl_start_matmul(cmd_fire),
+  .ctrl_start_matmul(start_fire),
   .ctrl_start_ready(sa_idle),
-  .ctrl_inner_dimension(cmd_matmul_inner_dimension)
+  .ctrl_inner_dimension(flush_fire ? 20'd0 : inner_dimension),
+  .ctrl_accumulate((partial_fire && cmd_matmul_partial_accumulate) || flush_fire),
+  .ctrl_write_back(!partial_fire)
 );
 
 always @(posedge clock) begin
@@ -89,7 +139,8 @@ always @(posedge clock) begin
     state <= `IDLE;
   end else begin
     if (state == `IDLE) begin
-      if (cmd_fire) begin
+      if (start_fire) begin
+        running <= cmd_fire ? `RUN_MATMUL : (partial_fire ? `RUN_PARTIAL : `RUN_FLUSH);
         state <= `GO;
       end
     end else if (state == `GO) begin
@@ -97,11 +148,58 @@ always @(posedge clock) begin
         state <= `RESPONSE;
       end
     end else if (state == `RESPONSE) begin
-      if (resp_matmul_ready) begin
+      if (resp_fire) begin
         state <= `IDLE;
       end
     end
   end
 end
 
+// performance counters, same layout as perf.PerfCounterBank:
+// 0 total cycles, 1 busy, 2 writer stall, 3 commands completed,
+// 4 weights stall, 5 activations stall
+localparam N_COUNTERS = 6;
+reg [63:0] counters [0:(N_COUNTERS-1)];
+// operand beats still expected for the running command
+reg [19:0] beats_left;
+wire [(N_COUNTERS-1):0] counter_inc = {
+  beats_left != 0 && !activations_data_valid,
+  beats_left != 0 && !weights_data_valid,
+  resp_fire,
+  vec_out_data_valid && !vec_out_data_ready,
+  state != `IDLE,
+  1'b1
+};
+
+// both commands answer right away, so hold a request until its response can go out
+assign cmd_read_counters_ready = resp_read_counters_ready;
+assign resp_read_counters_valid = cmd_read_counters_valid;
+assign resp_read_counters_value = (cmd_read_counters_counter_id < N_COUNTERS) ?
+        counters[cmd_read_counters_counter_id] : 64'd0;
+assign cmd_reset_counters_ready = resp_reset_counters_ready;
+assign resp_reset_counters_valid = cmd_reset_counters_valid;
+wire clear_counters = cmd_reset_counters_valid && cmd_reset_counters_ready;
+
+integer c;
+always @(posedge clock) begin
+  if (areset || clear_counters) begin
+    for (c = 0; c < N_COUNTERS; c = c + 1) begin
+      counters[c] <= 0;
+    end
+  end else begin
+    for (c = 0; c < N_COUNTERS; c = c + 1) begin
+      if (counter_inc[c]) begin
+        counters[c] <= counters[c] + 1;
+      end
+    end
+  end
+  if (areset) begin
+    beats_left <= 0;
+  end else if (cmd_fire || partial_fire) begin
+    beats_left <= inner_dimension;
+  end else if (weights_data_valid && weights_data_ready && beats_left != 0) begin
+    beats_left <= beats_left - 1;
+  end
+end
+
 endmodule
@@ -100,7 +100,10 @@ SystolicArray #(.DATA_WIDTH_BITS(DATA_WIDTH_BITS), .FRAC_BITS(FRAC_BITS), .INT_B
 
   .ctrl_start_matmul(),
   .ctrl_start_ready(sa_idle),
-  .ctrl_inner_dimension()
+  .ctrl_inner_dimension(),
+  // every matmul starts from cleared accumulators and writes its tile back
+  .ctrl_accumulate(1'b0),
+  .ctrl_write_back(1'b1)
 );
 
 always @(posedge clock) begin
@@ -0,0 +1,46 @@
+# Common setup for the host-program CMakeLists (the repository root, src/test/c
+# and its per-kernel subdirectories). Include it right after project().
+
+# run host programs against the C++ functional models in src/test/c/emulation
+# instead of an RTL simulation (no Beethoven install needed, bit-exact, much faster)
+option(BEETHOVEN_EMULATION "Build host code against the functional emulation backend" OFF)
+if(BEETHOVEN_EMULATION)
+    include(${CMAKE_CURRENT_LIST_DIR}/emulation/BeethovenEmulation.cmake)
+    # the emulated testbenches run in milliseconds, so they double as ctest tests
+    enable_testing()
+else()
+    find_package(beethoven REQUIRED)
+endif()
+
+# the golden models pick AVX2/AVX-512 kernels when the compiler targets them.
+# Only emulated builds default to the build machine's extensions: a hardware
+# testbench built with them on a dev box can die with SIGILL on the F2 host.
+option(GOLDEN_NATIVE_ARCH "Compile host code for the build machine's SIMD extensions" ${BEETHOVEN_EMULATION})
+if(GOLDEN_NATIVE_ARCH)
+    add_compile_options(-march=native)
+endif()
+find_package(Threads REQUIRED)
+link_libraries(Threads::Threads)
+
+# beethoven_host_test(<target> [args...]): run the target as a ctest test in
+# emulated builds; the target must exit nonzero when a check fails
+function(beethoven_host_test name)
+    if(BEETHOVEN_EMULATION)
+        add_test(NAME ${name} COMMAND ${name} ${ARGN})
+    endif()
+endfunction()
+
+# beethoven_python_test(<module> <script> <case>...): run `python <script> <case>`
+# for each case as a ctest test in emulated builds, with the module on the
+# PYTHONPATH; the scripts flag a failed check with ❌ rather than an exit status
+function(beethoven_python_test module script)
+    if(BEETHOVEN_EMULATION)
+        find_package(Python3 COMPONENTS Interpreter REQUIRED)
+        foreach(case ${ARGN})
+            add_test(NAME ${module}_${case} COMMAND ${Python3_EXECUTABLE} ${script} ${case})
+            set_tests_properties(${module}_${case} PROPERTIES
+                ENVIRONMENT PYTHONPATH=$<TARGET_FILE_DIR:${module}>
+                FAIL_REGULAR_EXPRESSION "❌")
+        endforeach()
+    endif()
+endfunction()
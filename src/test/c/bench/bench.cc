@@ -0,0 +1,337 @@
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "../common/pool_allocator.h"
+#include "../common/trace.h"
+#ifdef FIR_N_CORES
+// the FIR build targets AWS F2, where the bulk copies don't work yet
+#include "../common/dma.h"
+#endif
+
+// Throughput / latency sweeps for the template's accelerators.
+//
+// One source serves every hardware build: each kernel's sweep is compiled in
+// when the linked beethoven_hardware.h exports its *_N_CORES definition.
+// Every configuration (problem size x cores x batch depth) is run `reps`
+// times and reported separately as
+//   - h2d: copy_to_fpga of all inputs
+//   - command latency: issue -> response for each command (p50/p99)
+//   - d2h: copy_from_fpga of all outputs
+// The FIR sweep moves its buffers with dma::copy_to_fpga/copy_from_fpga, so
+// its h2d/d2h numbers are those of the DMAHelper path it uses on F2.
+// plus compute throughput in elements (or MACs) per second. Results are
+// written as JSON to stdout or to --out <file>. Buffers come from a
+// pool::pool_allocator and go back to it after each configuration, so the
+// sweep reuses segments instead of allocating for every point. The pool
+// rounds sizes up to a size class, which for the power-of-two sizes swept
+// here (64 bytes and up) is the size itself.
+//
+// usage: beethoven_bench [--reps N] [--out results.json] [--quick]
+
+using namespace beethoven;
+using bench_clock = std::chrono::steady_clock;
+
+// skip configurations whose buffers would hold more elements than this in total
+constexpr double max_resident_elements = 1 << 23;
+
+static double us_since(bench_clock::time_point t) {
+  return std::chrono::duration<double, std::micro>(bench_clock::now() - t).count();
+}
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t idx = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+  return v[idx];
+}
+
+static double mean(const std::vector<double> &v) {
+  double sum = 0;
+  for (auto x : v) sum += x;
+  return v.empty() ? 0 : sum / v.size();
+}
+
+struct bench_result {
+  std::string kernel;
+  std::string unit;
+  size_t size;
+  int cores;
+  int depth;
+  double work_per_rep;  // elements or MACs
+  std::vector<double> h2d_us{}, d2h_us{}, wall_us{}, cmd_us{};
+};
+
+// one timed repetition: copy inputs over with to_fpga, keep `depth` commands
+// per core in flight, wait for all of them, copy outputs back with from_fpga
+template <typename Issue, typename ToFpga, typename FromFpga>
+static void run_rep(bench_result &r, std::vector<remote_ptr> &inputs,
+                    std::vector<remote_ptr> &outputs, Issue issue, ToFpga to_fpga,
+                    FromFpga from_fpga) {
+  auto t = bench_clock::now();
+  for (auto &in : inputs) to_fpga(in);
+  r.h2d_us.push_back(us_since(t));
+
+  using response = decltype(issue(0, 0));
+  std::vector<std::pair<response, bench_clock::time_point>> in_flight;
+  auto start = bench_clock::now();
+  for (int d = 0; d < r.depth; ++d) {
+    for (int c = 0; c < r.cores; ++c) {
+      auto issued = bench_clock::now();
+      in_flight.emplace_back(issue(c, d), issued);
+    }
+  }
+  // responses are collected in issue order, so a command's latency includes
+  // any time spent queued behind earlier commands on the same core
+  for (auto &cmd : in_flight) {
+    cmd.first.get();
+    r.cmd_us.push_back(us_since(cmd.second));
+  }
+  r.wall_us.push_back(us_since(start));
+
+  t = bench_clock::now();
+  for (auto &out : outputs) from_fpga(out);
+  r.d2h_us.push_back(us_since(t));
+}
+
+// the same, with the handle's bulk copies
+template <typename Issue>
+static void run_rep(fpga_handle_t &handle, bench_result &r, std::vector<remote_ptr> &inputs,
+                    std::vector<remote_ptr> &outputs, Issue issue) {
+  run_rep(r, inputs, outputs, issue, [&](const remote_ptr &p) { handle.copy_to_fpga(p); },
+          [&](const remote_ptr &p) { handle.copy_from_fpga(p); });
+}
+
+static std::vector<int> core_sweep(int n_cores) {
+  std::vector<int> sweep;
+  for (int c = 1; c < n_cores; c *= 2) sweep.push_back(c);
+  sweep.push_back(n_cores);
+  return sweep;
+}
+
+#ifdef VECTOR_ADD_N_CORES
+static void bench_vector_add(pool::pool_allocator &pool, std::vector<bench_result> &results,
+                             int reps, bool quick) {
+  auto &handle = pool.get_handle();
+  std::vector<size_t> sizes = quick ? std::vector<size_t>{1 << 10}
+                                    : std::vector<size_t>{1 << 10, 1 << 14, 1 << 18, 1 << 20};
+  std::vector<int> depths = quick ? std::vector<int>{1} : std::vector<int>{1, 4, 16};
+  for (auto n : sizes) {
+    for (int cores : core_sweep(VECTOR_ADD_N_CORES)) {
+      for (int depth : depths) {
+        if (double(n) * cores * depth > max_resident_elements) continue;
+        bench_result r{"vector_add", "elements", n, cores, depth, double(n) * cores * depth};
+        pool::pool_allocator::arena buffers(pool);
+        std::vector<remote_ptr> a, b, out;
+        for (int i = 0; i < cores * depth; ++i) {
+          a.push_back(buffers.malloc(sizeof(int) * n));
+          b.push_back(buffers.malloc(sizeof(int) * n));
+          out.push_back(buffers.malloc(sizeof(int) * n));
+          std::memset(a.back().getHostAddr(), 1, sizeof(int) * n);
+          std::memset(b.back().getHostAddr(), 2, sizeof(int) * n);
+        }
+        std::vector<remote_ptr> inputs(a);
+        inputs.insert(inputs.end(), b.begin(), b.end());
+        for (int rep = 0; rep < reps; ++rep) {
+          run_rep(handle, r, inputs, out, [&](int c, int d) {
+            int i = d * cores + c;
+            return myVectorAdd::vector_add(c, a[i], b[i], out[i], n);
+          });
+        }
+        results.push_back(r);
+      }
+    }
+  }
+}
+#endif
+
+#ifdef VECTOR_DOT_N_CORES
+// one dot product per command, nothing to copy back but the response
+static void bench_reduce(pool::pool_allocator &pool, std::vector<bench_result> &results,
+                         int reps, bool quick) {
+  auto &handle = pool.get_handle();
+  std::vector<size_t> sizes = quick ? std::vector<size_t>{1 << 10}
+                                    : std::vector<size_t>{1 << 10, 1 << 14, 1 << 18, 1 << 20};
+  std::vector<int> depths = quick ? std::vector<int>{1} : std::vector<int>{1, 4, 16};
+  for (auto n : sizes) {
+    for (int cores : core_sweep(VECTOR_DOT_N_CORES)) {
+      for (int depth : depths) {
+        if (double(n) * cores * depth > max_resident_elements) continue;
+        bench_result r{"vector_dot", "elements", n, cores, depth, double(n) * cores * depth};
+        pool::pool_allocator::arena buffers(pool);
+        std::vector<remote_ptr> a, b, none;
+        for (int i = 0; i < cores * depth; ++i) {
+          a.push_back(buffers.malloc(sizeof(int) * n));
+          b.push_back(buffers.malloc(sizeof(int) * n));
+          std::memset(a.back().getHostAddr(), 1, sizeof(int) * n);
+          std::memset(b.back().getHostAddr(), 2, sizeof(int) * n);
+        }
+        std::vector<remote_ptr> inputs(a);
+        inputs.insert(inputs.end(), b.begin(), b.end());
+        for (int rep = 0; rep < reps; ++rep) {
+          run_rep(handle, r, inputs, none, [&](int c, int d) {
+            int i = d * cores + c;
+            return myVectorDot::reduce(c, 0, a[i], b[i], n);
+          });
+        }
+        results.push_back(r);
+      }
+    }
+  }
+}
+#endif
+
+#ifdef FIR_N_CORES
+static void bench_fir(pool::pool_allocator &pool, std::vector<bench_result> &results,
+                      int reps, bool quick) {
+  for (int core = 0; core < FIR_N_CORES; ++core) {
+    for (int i = 0; i < ACCEL_WINDOW_SIZE; ++i) {
+      FIR::set_taps(core, i, i + 1);
+    }
+  }
+  std::vector<size_t> sizes = quick ? std::vector<size_t>{1 << 10}
+                                    : std::vector<size_t>{1 << 10, 1 << 14, 1 << 18, 1 << 20};
+  std::vector<int> depths = quick ? std::vector<int>{1} : std::vector<int>{1, 4, 16};
+  for (auto n : sizes) {
+    for (int cores : core_sweep(FIR_N_CORES)) {
+      for (int depth : depths) {
+        if (double(n) * cores * depth > max_resident_elements) continue;
+        bench_result r{"fir", "samples", n, cores, depth, double(n) * cores * depth};
+        pool::pool_allocator::arena buffers(pool);
+        std::vector<remote_ptr> in, out;
+        for (int i = 0; i < cores * depth; ++i) {
+          in.push_back(buffers.malloc(sizeof(int) * n));
+          out.push_back(buffers.malloc(sizeof(int) * n));
+          std::memset(in.back().getHostAddr(), 3, sizeof(int) * n);
+        }
+        for (int rep = 0; rep < reps; ++rep) {
+          run_rep(
+              r, in, out,
+              [&](int c, int d) {
+                int i = d * cores + c;
+                return FIR::do_filter(c, in[i], n, out[i]);
+              },
+              [](const remote_ptr &p) { dma::copy_to_fpga(p); },
+              [](const remote_ptr &p) { dma::copy_from_fpga(p); });
+        }
+        results.push_back(r);
+      }
+    }
+  }
+}
+#endif
+
+#ifdef SYSTOLIC_ARRAY_N_CORES
+static void bench_matmul(pool::pool_allocator &pool, std::vector<bench_result> &results,
+                         int reps, bool quick) {
+  auto &handle = pool.get_handle();
+  // size is the inner dimension of one DIM x DIM output tile
+  std::vector<size_t> sizes = quick ? std::vector<size_t>{64}
+                                    : std::vector<size_t>{64, 512, 4096, 32768};
+  std::vector<int> depths = quick ? std::vector<int>{1} : std::vector<int>{1, 4, 16};
+  const size_t tile_bytes = (size_t)DATA_WIDTH_BYTES * SYSTOLIC_ARRAY_DIM * SYSTOLIC_ARRAY_DIM;
+  for (auto k : sizes) {
+    for (int cores : core_sweep(SYSTOLIC_ARRAY_N_CORES)) {
+      for (int depth : depths) {
+        if (double(k) * SYSTOLIC_ARRAY_DIM * cores * depth > max_resident_elements) continue;
+        double macs = double(k) * SYSTOLIC_ARRAY_DIM * SYSTOLIC_ARRAY_DIM;
+        bench_result r{"matmul", "MACs", k, cores, depth, macs * cores * depth};
+        size_t panel_bytes = (size_t)DATA_WIDTH_BYTES * SYSTOLIC_ARRAY_DIM * k;
+        pool::pool_allocator::arena buffers(pool);
+        std::vector<remote_ptr> act, wgt, out;
+        for (int i = 0; i < cores * depth; ++i) {
+          act.push_back(buffers.malloc(panel_bytes));
+          wgt.push_back(buffers.malloc(panel_bytes));
+          out.push_back(buffers.malloc(tile_bytes));
+          std::memset(act.back().getHostAddr(), 0, panel_bytes);
+          std::memset(wgt.back().getHostAddr(), 0, panel_bytes);
+        }
+        std::vector<remote_ptr> inputs(act);
+        inputs.insert(inputs.end(), wgt.begin(), wgt.end());
+        for (int rep = 0; rep < reps; ++rep) {
+          run_rep(handle, r, inputs, out, [&](int c, int d) {
+            int i = d * cores + c;
+            return SystolicArrayCore::matmul(c, act[i].getFpgaAddr(), k, out[i].getFpgaAddr(),
+                                             wgt[i].getFpgaAddr());
+          });
+        }
+        results.push_back(r);
+      }
+    }
+  }
+}
+#endif
+
+static void write_json(FILE *f, const std::vector<bench_result> &results) {
+  fprintf(f, "[\n");
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto &r = results[i];
+    double wall_s = mean(r.wall_us) * 1e-6;
+    fprintf(f,
+            "  {\"kernel\": \"%s\", \"size\": %zu, \"cores\": %d, \"batch_depth\": %d, "
+            "\"reps\": %zu,\n"
+            "   \"throughput\": %.6g, \"throughput_unit\": \"%s/s\",\n"
+            "   \"h2d_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f},\n"
+            "   \"command_latency_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f},\n"
+            "   \"d2h_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f}}%s\n",
+            r.kernel.c_str(), r.size, r.cores, r.depth, r.wall_us.size(),
+            wall_s > 0 ? r.work_per_rep / wall_s : 0.0, r.unit.c_str(), mean(r.h2d_us),
+            percentile(r.h2d_us, 0.5), percentile(r.h2d_us, 0.99), mean(r.cmd_us),
+            percentile(r.cmd_us, 0.5), percentile(r.cmd_us, 0.99), mean(r.d2h_us),
+            percentile(r.d2h_us, 0.5), percentile(r.d2h_us, 0.99),
+            i + 1 == results.size() ? "" : ",");
+  }
+  fprintf(f, "]\n");
+}
+
+int main(int argc, char **argv) {
+  trace::init_from_env();
+  int reps = 10;
+  bool quick = false;
+  const char *out_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+      reps = std::max(1, atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--out") && i + 1 < argc) {
+      out_path = argv[++i];
+    } else if (!strcmp(argv[i], "--quick")) {
+      quick = true;
+    } else {
+      fprintf(stderr, "usage: %s [--reps N] [--out results.json] [--quick]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  fpga_handle_t handle;
+  pool::pool_allocator pool(handle);
+  std::vector<bench_result> results;
+#ifdef VECTOR_ADD_N_CORES
+  bench_vector_add(pool, results, reps, quick);
+#endif
+#ifdef VECTOR_DOT_N_CORES
+  bench_reduce(pool, results, reps, quick);
+#endif
+#ifdef FIR_N_CORES
+  bench_fir(pool, results, reps, quick);
+#endif
+#ifdef SYSTOLIC_ARRAY_N_CORES
+  bench_matmul(pool, results, reps, quick);
+#endif
+
+  FILE *f = out_path ? fopen(out_path, "w") : stdout;
+  if (!f) {
+    perror(out_path);
+    return 1;
+  }
+  write_json(f, results);
+  if (out_path) fclose(f);
+  pool.trim();
+  handle.shutdown();
+}
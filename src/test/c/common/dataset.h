@@ -0,0 +1,324 @@
+#ifndef BEETHOVEN_TEMPLATE_DATASET_H
+#define BEETHOVEN_TEMPLATE_DATASET_H
+
+#include <beethoven/fpga_handle.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "trace.h"
+
+// Binary tensor files, memory-mapped and streamed into device buffers.
+//
+// A file is a 64-byte little-endian header followed by the elements,
+// row-major, starting at data_offset (a multiple of 64, so the mapped data is
+// as aligned as a handle.malloc buffer):
+//   0  char[4]     magic "BTEN"
+//   4  uint16_t    version (1)
+//   6  uint8_t     dtype: 0 two's-complement integer, 1 sign-magnitude fixed
+//                  point (the systolic array's element format), 2 IEEE float
+//   7  uint8_t     bytes per element (1, 2, 4 or 8)
+//   8  uint8_t     rank (0..4)
+//   9  uint8_t     frac_bits, fixed point only
+//   10 uint8_t     int_bits, fixed point only
+//   11 uint8_t     reserved, 0
+//   12 uint32_t    data_offset
+//   16 uint64_t[4] shape, unused dimensions 0
+//   48 reserved, 0
+//
+// file maps the whole thing read-only with MADV_SEQUENTIAL, so host code can
+// hand as<T>() straight to anything that takes a host pointer (fir::stream,
+// systolic::gemm's packers) without reading it into a temporary first.
+// load() instead reads the data into a device buffer's host side in
+// chunk_bytes steps: the next chunk is prefetched with MADV_WILLNEED while
+// the current one is faulted in, and the pages already read are dropped from
+// the mapping, so a multi-GB capture never has more than a few chunks of the
+// file resident. The handle's copy_to_fpga always moves a remote_ptr's whole
+// allocation, so load() copies the buffer over once it's filled. With a copy
+// that moves just the segment it's given (dma::copy_to_fpga), load_into()
+// and the load() overload taking one overlap each chunk's transfer with the
+// read of the next.
+
+namespace dataset {
+using namespace beethoven;
+
+enum class dtype : uint8_t { integer = 0, fixed_point = 1, floating = 2 };
+
+constexpr int max_rank = 4;
+constexpr size_t header_bytes = 64;
+constexpr size_t default_chunk_bytes = size_t(4) << 20;
+
+struct header {
+  dtype type = dtype::integer;
+  int elem_bytes = 0;
+  int frac_bits = 0;
+  int int_bits = 0;
+  std::vector<uint64_t> shape;
+
+  size_t elements() const {
+    size_t n = 1;
+    for (auto d : shape) n *= d;
+    return n;
+  }
+  size_t bytes() const { return elements() * elem_bytes; }
+};
+
+// header for plain integer or float elements of type T
+template <typename T>
+header describe(std::vector<uint64_t> shape) {
+  static_assert(std::is_arithmetic_v<T>, "dataset elements are integers or floats");
+  return {std::is_floating_point_v<T> ? dtype::floating : dtype::integer, (int)sizeof(T), 0, 0,
+          std::move(shape)};
+}
+
+// header for sign-magnitude fixed-point elements stored in T
+template <typename T>
+header describe_fixed(std::vector<uint64_t> shape, int frac_bits, int int_bits) {
+  static_assert(std::is_integral_v<T>, "fixed-point elements are stored as integers");
+  return {dtype::fixed_point, (int)sizeof(T), frac_bits, int_bits, std::move(shape)};
+}
+
+namespace detail {
+
+struct raw_header {
+  char magic[4];
+  uint16_t version;
+  uint8_t type;
+  uint8_t elem_bytes;
+  uint8_t rank;
+  uint8_t frac_bits;
+  uint8_t int_bits;
+  uint8_t reserved0;
+  uint32_t data_offset;
+  uint64_t shape[max_rank];
+  uint8_t reserved1[16];
+};
+static_assert(sizeof(raw_header) == header_bytes, "dataset header must be 64 bytes");
+
+constexpr char magic[4] = {'B', 'T', 'E', 'N'};
+constexpr uint16_t version = 1;
+
+inline void check(const header &h, const std::string &path) {
+  bool width_ok = h.elem_bytes == 1 || h.elem_bytes == 2 || h.elem_bytes == 4 || h.elem_bytes == 8;
+  if (!width_ok || (h.type == dtype::floating && h.elem_bytes < 4) ||
+      (int)h.type > (int)dtype::floating || (int)h.shape.size() > max_rank) {
+    throw std::runtime_error("Unsupported dataset element type or rank: " + path);
+  }
+  if (h.type == dtype::fixed_point && h.frac_bits + h.int_bits + 1 != 8 * h.elem_bytes) {
+    throw std::runtime_error("Dataset fixed-point format doesn't fill its elements: " + path);
+  }
+}
+
+} // namespace detail
+
+inline void write(const std::string &path, const header &h, const void *data) {
+  detail::check(h, path);
+  detail::raw_header raw{};
+  std::memcpy(raw.magic, detail::magic, sizeof(raw.magic));
+  raw.version = detail::version;
+  raw.type = (uint8_t)h.type;
+  raw.elem_bytes = (uint8_t)h.elem_bytes;
+  raw.rank = (uint8_t)h.shape.size();
+  raw.frac_bits = (uint8_t)h.frac_bits;
+  raw.int_bits = (uint8_t)h.int_bits;
+  raw.data_offset = header_bytes;
+  std::copy(h.shape.begin(), h.shape.end(), raw.shape);
+
+  FILE *f = std::fopen(path.c_str(), "wb");
+  if (!f) {
+    throw std::runtime_error("Can't create dataset " + path);
+  }
+  bool ok = std::fwrite(&raw, sizeof(raw), 1, f) == 1 &&
+            (h.bytes() == 0 || std::fwrite(data, h.bytes(), 1, f) == 1);
+  ok &= std::fclose(f) == 0;
+  if (!ok) {
+    throw std::runtime_error("Failed writing dataset " + path);
+  }
+}
+
+// a read-only mapping of one dataset file
+class file {
+private:
+  std::string path;
+  header hdr;
+  void *map = MAP_FAILED;
+  size_t map_bytes = 0;
+  size_t data_offset = 0;
+
+  // madvise the pages covering [offset, offset + len) of the data
+  void advise(size_t offset, size_t len, int advice) const {
+    if (len == 0 || offset >= hdr.bytes()) return;
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (data_offset + offset) / page * page;
+    size_t end = std::min(data_offset + offset + len, map_bytes);
+    madvise((char *)map + start, end - start, advice);
+  }
+
+  template <typename T>
+  const T *typed(dtype type) const {
+    if (hdr.type != type || hdr.elem_bytes != (int)sizeof(T)) {
+      throw std::runtime_error("Dataset " + path + " doesn't hold elements of the requested type");
+    }
+    return (const T *)data();
+  }
+
+public:
+  explicit file(const std::string &path) : path(path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Can't open dataset " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= header_bytes) {
+      map_bytes = st.st_size;
+      map = mmap(nullptr, map_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+      throw std::runtime_error("Can't map dataset " + path);
+    }
+
+    detail::raw_header raw;
+    std::memcpy(&raw, map, sizeof(raw));
+    if (std::memcmp(raw.magic, detail::magic, sizeof(raw.magic)) != 0 ||
+        raw.version != detail::version) {
+      munmap(map, map_bytes);
+      throw std::runtime_error("Not a version 1 dataset: " + path);
+    }
+    hdr.type = (dtype)raw.type;
+    hdr.elem_bytes = raw.elem_bytes;
+    hdr.frac_bits = raw.frac_bits;
+    hdr.int_bits = raw.int_bits;
+    hdr.shape.assign(raw.shape, raw.shape + std::min<int>(raw.rank, max_rank));
+    data_offset = raw.data_offset;
+    try {
+      detail::check(hdr, path);
+      if (raw.rank > max_rank || data_offset % header_bytes != 0 || data_offset < header_bytes ||
+          data_offset > map_bytes || map_bytes - data_offset < hdr.bytes()) {
+        throw std::runtime_error("Dataset " + path + " is truncated or has a bad header");
+      }
+    } catch (...) {
+      munmap(map, map_bytes);
+      throw;
+    }
+    madvise(map, map_bytes, MADV_SEQUENTIAL);
+  }
+
+  file(const file &) = delete;
+  file &operator=(const file &) = delete;
+
+  ~file() { munmap(map, map_bytes); }
+
+  const header &info() const { return hdr; }
+  size_t bytes() const { return hdr.bytes(); }
+  const void *data() const { return (const char *)map + data_offset; }
+
+  // the elements of an integer or float file
+  template <typename T>
+  const T *as() const {
+    return typed<T>(std::is_floating_point_v<T> ? dtype::floating : dtype::integer);
+  }
+
+  // the elements of a fixed-point file, which must be in the given format
+  template <typename T>
+  const T *as_fixed(int frac_bits, int int_bits) const {
+    if (hdr.type == dtype::fixed_point &&
+        (hdr.frac_bits != frac_bits || hdr.int_bits != int_bits)) {
+      throw std::runtime_error("Dataset " + path + " is fixed point in a different format");
+    }
+    return typed<T>(dtype::fixed_point);
+  }
+
+  // start reading [offset, offset + len) of the data in the background
+  void prefetch(size_t offset, size_t len) const { advise(offset, len, MADV_WILLNEED); }
+
+  // drop the pages of [offset, offset + len) once they've been consumed;
+  // they're read from the file again if touched later
+  void release(size_t offset, size_t len) const { advise(offset, len, MADV_DONTNEED); }
+};
+
+namespace detail {
+
+// read f's data into dst's host side in chunk_bytes steps, calling
+// filled(segment) with each chunk once it's in place
+template <typename Filled>
+void read_chunks(const file &f, const remote_ptr &dst, size_t chunk_bytes, Filled &&filled) {
+  if (chunk_bytes == 0 || dst.getLen() < f.bytes()) {
+    throw std::runtime_error("Dataset load needs a non-zero chunk and a large enough buffer");
+  }
+  auto *src = (const char *)f.data();
+  auto *host = (char *)dst.getHostAddr();
+  f.prefetch(0, chunk_bytes);
+  for (size_t offset = 0; offset < f.bytes(); offset += chunk_bytes) {
+    size_t len = std::min(chunk_bytes, f.bytes() - offset);
+    f.prefetch(offset + chunk_bytes, chunk_bytes);
+    std::memcpy(host + offset, src + offset, len);
+    f.release(offset, len);
+    filled(remote_ptr(dst.getFpgaAddr() + offset, host + offset, len));
+  }
+}
+
+} // namespace detail
+
+// Stream f's data into dst (at least f.bytes() long) in chunk_bytes steps,
+// with copy(segment) moving each filled chunk to the device on another
+// thread while the next one is read. copy must move only the segment it's
+// given, e.g. [](const remote_ptr &p) { dma::copy_to_fpga(p); }; the
+// handle's copy_to_fpga moves the whole allocation, so it can't be used here.
+template <typename Copy>
+void load_into(const file &f, const remote_ptr &dst, size_t chunk_bytes, Copy &&copy) {
+  trace::scope span("dataset_load", -1, f.bytes());
+  // copying = the previous chunk's transfer, which overlaps the next read
+  std::future<void> copying;
+  detail::read_chunks(f, dst, chunk_bytes, [&](const remote_ptr &segment) {
+    if (copying.valid()) {
+      copying.get();
+    }
+    copying = std::async(std::launch::async, [&copy, segment] { copy(segment); });
+  });
+  if (copying.valid()) {
+    copying.get();
+  }
+}
+
+template <typename Copy>
+remote_ptr load(fpga_handle_t &handle, const file &f, size_t chunk_bytes, Copy &&copy) {
+  auto dst = trace::malloc(handle, std::max<size_t>(f.bytes(), 1));
+  try {
+    load_into(f, dst, chunk_bytes, copy);
+  } catch (...) {
+    handle.free(dst);
+    throw;
+  }
+  return dst;
+}
+
+// a device buffer holding f's data, read in chunks and then moved with one
+// bulk copy of the whole buffer
+inline remote_ptr load(fpga_handle_t &handle, const file &f,
+                       size_t chunk_bytes = default_chunk_bytes) {
+  auto dst = trace::malloc(handle, std::max<size_t>(f.bytes(), 1));
+  try {
+    trace::scope span("dataset_load", -1, f.bytes());
+    detail::read_chunks(f, dst, chunk_bytes, [](const remote_ptr &) {});
+    trace::copy_to_fpga(handle, dst);
+  } catch (...) {
+    handle.free(dst);
+    throw;
+  }
+  return dst;
+}
+
+} // namespace dataset
+
+#endif
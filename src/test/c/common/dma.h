@@ -0,0 +1,86 @@
+#ifndef BEETHOVEN_TEMPLATE_DMA_H
+#define BEETHOVEN_TEMPLATE_DMA_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include "trace.h"
+
+// Pipelined host <-> FPGA transfers over the DMAHelper core.
+//
+// On AWS F2 the bulk copy_to_fpga/copy_from_fpga path is not usable yet, so
+// data has to move one 32-bit word per DMAHelper::memcmd. Waiting on every
+// response serializes a full round trip per word. Instead, these helpers keep
+// up to `window` memcmds in flight and only block once the window is full,
+// so the command/response latency overlaps with the following issues.
+//
+// Both functions are drop-in replacements for the fpga_handle_t methods of
+// the same name: they move the whole segment described by the remote_ptr.
+
+namespace dma {
+using namespace beethoven;
+
+constexpr int word_bytes = 4;
+constexpr int default_window = 256;
+
+using memcmd_response = decltype(DMAHelper::memcmd(0, remote_ptr(), 0, 0));
+
+inline void copy_to_fpga(const remote_ptr &q, int window = default_window) {
+  trace::scope span("dma_copy_to_fpga", -1, q.getLen());
+  auto *bytes = (const uint8_t *)q.getHostAddr();
+  size_t n_words = q.getLen() / word_bytes;
+  size_t tail = q.getLen() % word_bytes;
+  std::deque<memcmd_response> in_flight;
+  for (size_t i = 0; i < n_words; ++i) {
+    if ((int)in_flight.size() >= window) {
+      in_flight.front().get();
+      in_flight.pop_front();
+    }
+    uint32_t word;
+    std::memcpy(&word, bytes + i * word_bytes, word_bytes);
+    in_flight.push_back(DMAHelper::memcmd(0, q + i * word_bytes, word, 1));
+  }
+  for (auto &resp : in_flight) {
+    resp.get();
+  }
+  if (tail) {
+    // read-modify-write so we don't clobber the bytes past the segment
+    auto last = q + n_words * word_bytes;
+    uint32_t word = DMAHelper::memcmd(0, last, 0, 0).get().payload;
+    std::memcpy(&word, bytes + n_words * word_bytes, tail);
+    DMAHelper::memcmd(0, last, word, 1).get();
+  }
+}
+
+inline void copy_from_fpga(const remote_ptr &q, int window = default_window) {
+  trace::scope span("dma_copy_from_fpga", -1, q.getLen());
+  auto *bytes = (uint8_t *)q.getHostAddr();
+  size_t n_words = (q.getLen() + word_bytes - 1) / word_bytes;
+  // responses come back in issue order, so the front of the queue is always
+  // the lowest outstanding word
+  std::deque<memcmd_response> in_flight;
+  size_t retired = 0;
+  auto retire = [&]() {
+    uint32_t word = in_flight.front().get().payload;
+    size_t n = std::min<size_t>(word_bytes, q.getLen() - retired * word_bytes);
+    std::memcpy(bytes + retired * word_bytes, &word, n);
+    in_flight.pop_front();
+    ++retired;
+  };
+  for (size_t i = 0; i < n_words; ++i) {
+    if ((int)in_flight.size() >= window) {
+      retire();
+    }
+    in_flight.push_back(DMAHelper::memcmd(0, q + i * word_bytes, 0, 0));
+  }
+  while (!in_flight.empty()) {
+    retire();
+  }
+}
+
+} // namespace dma
+
+#endif
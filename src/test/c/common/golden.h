@@ -0,0 +1,263 @@
+#ifndef BEETHOVEN_TEMPLATE_GOLDEN_H
+#define BEETHOVEN_TEMPLATE_GOLDEN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if defined(__AVX2__) || defined(__AVX512BW__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// Bit-exact reference models for the template's accelerators.
+//
+// Each kernel has a scalar definition and, when the compiler targets them,
+// AVX2 and AVX-512 versions that compute the same thing lane-wise. The SIMD
+// paths are selected at compile time (build with -march=native or -mavx2 /
+// -mavx512bw), so the scalar code is always what the vector code is checked
+// against.
+//
+//  - gemm: sign-magnitude fixed-point in int8_t / int16_t / int32_t,
+//    accumulated in k order exactly like ProcessingElement.v (truncated
+//    product, wrapping magnitude sum whose top bit flips the sign); the SIMD
+//    paths cover the 16-bit format
+//  - fir: 32-bit taps/samples, products and sum wrap to 32 bits like the
+//    FIR core's output channel
+//  - vector_add: 32-bit wrapping add
+//  - reduce: dot / sum / min / max / squared L2 norm of signed 32-bit
+//    elements, sums and products wrapping to 64 bits like VectorReduce
+
+namespace golden {
+
+////////////////////////////// sign-magnitude GEMM ////////////////////////////
+
+template <int frac_bits, typename T>
+inline T mac(T acc, T wgt, T act) {
+  using U = std::make_unsigned_t<T>;
+  constexpr int bits = 8 * sizeof(T);
+  const uint64_t sign = uint64_t(1) << (bits - 1);
+  const uint64_t mag = sign - 1;
+  uint64_t a = (U)acc, w = (U)wgt, x = (U)act;
+  uint64_t product_f = (((w & mag) * (x & mag)) >> frac_bits) & mag;
+  bool product_s = ((w ^ x) & sign) != 0;
+  bool acc_s = (a & sign) != 0;
+  uint64_t adj_product_f = (product_s != acc_s) ? (~product_f + 1) & mag : product_f;
+  uint64_t addition = ((a & mag) + adj_product_f) & mag;
+  uint64_t oflow = (addition >> (bits - 2)) & 1;
+  uint64_t n_acc_f = ((addition ^ (oflow ? mag : 0)) + oflow) & mag;
+  return (T)(U)(((acc_s ^ oflow) ? sign : 0) | n_acc_f);
+}
+
+#if defined(__AVX512BW__)
+template <int frac_bits>
+inline __m512i mac_x32(__m512i acc, __m512i wgt, __m512i act) {
+  const __m512i mag = _mm512_set1_epi16(0x7FFF);
+  const __m512i sign = _mm512_set1_epi16((short)0x8000);
+  __m512i wf = _mm512_and_si512(wgt, mag), af = _mm512_and_si512(act, mag);
+  // (wf * af) >> frac_bits, assembled from the low and high product halves
+  __m512i lo = _mm512_mullo_epi16(wf, af), hi = _mm512_mulhi_epu16(wf, af);
+  __m512i product_f = frac_bits == 0
+                          ? lo
+                          : _mm512_or_si512(_mm512_slli_epi16(hi, 16 - frac_bits),
+                                            _mm512_srli_epi16(lo, frac_bits));
+  product_f = _mm512_and_si512(product_f, mag);
+  __m512i acc_s = _mm512_and_si512(acc, sign);
+  // all-ones where product and accumulator signs differ
+  __m512i opp = _mm512_srai_epi16(_mm512_xor_si512(_mm512_xor_si512(wgt, act), acc), 15);
+  __m512i adj = _mm512_sub_epi16(_mm512_xor_si512(product_f, opp), opp);
+  __m512i addition = _mm512_and_si512(_mm512_add_epi16(_mm512_and_si512(acc, mag), adj), mag);
+  __m512i oflow = _mm512_srai_epi16(_mm512_slli_epi16(addition, 1), 15);
+  __m512i n_acc_f = _mm512_and_si512(_mm512_sub_epi16(_mm512_xor_si512(addition, oflow), oflow), mag);
+  __m512i n_acc_s = _mm512_xor_si512(acc_s, _mm512_and_si512(oflow, sign));
+  return _mm512_or_si512(n_acc_s, n_acc_f);
+}
+#endif
+
+#if defined(__AVX2__)
+template <int frac_bits>
+inline __m256i mac_x16(__m256i acc, __m256i wgt, __m256i act) {
+  const __m256i mag = _mm256_set1_epi16(0x7FFF);
+  const __m256i sign = _mm256_set1_epi16((short)0x8000);
+  __m256i wf = _mm256_and_si256(wgt, mag), af = _mm256_and_si256(act, mag);
+  __m256i lo = _mm256_mullo_epi16(wf, af), hi = _mm256_mulhi_epu16(wf, af);
+  __m256i product_f = frac_bits == 0
+                          ? lo
+                          : _mm256_or_si256(_mm256_slli_epi16(hi, 16 - frac_bits),
+                                            _mm256_srli_epi16(lo, frac_bits));
+  product_f = _mm256_and_si256(product_f, mag);
+  __m256i acc_s = _mm256_and_si256(acc, sign);
+  __m256i opp = _mm256_srai_epi16(_mm256_xor_si256(_mm256_xor_si256(wgt, act), acc), 15);
+  __m256i adj = _mm256_sub_epi16(_mm256_xor_si256(product_f, opp), opp);
+  __m256i addition = _mm256_and_si256(_mm256_add_epi16(_mm256_and_si256(acc, mag), adj), mag);
+  __m256i oflow = _mm256_srai_epi16(_mm256_slli_epi16(addition, 1), 15);
+  __m256i n_acc_f = _mm256_and_si256(_mm256_sub_epi16(_mm256_xor_si256(addition, oflow), oflow), mag);
+  __m256i n_acc_s = _mm256_xor_si256(acc_s, _mm256_and_si256(oflow, sign));
+  return _mm256_or_si256(n_acc_s, n_acc_f);
+}
+#endif
+
+// rows [row_begin, row_end) of C = A * B, all row-major
+template <int frac_bits, typename T>
+inline void gemm_rows(const T *A, const T *B, T *C, int K, int N, int row_begin, int row_end) {
+  for (int i = row_begin; i < row_end; ++i) {
+    T *c_row = C + (size_t)i * N;
+    std::fill(c_row, c_row + N, 0);
+    for (int k = 0; k < K; ++k) {
+      T a = A[(size_t)i * K + k];
+      const T *b_row = B + (size_t)k * N;
+      int j = 0;
+      if constexpr (sizeof(T) == 2) {
+#if defined(__AVX512BW__)
+        __m512i a32 = _mm512_set1_epi16(a);
+        for (; j + 32 <= N; j += 32) {
+          __m512i acc = _mm512_loadu_si512(c_row + j);
+          __m512i wgt = _mm512_loadu_si512(b_row + j);
+          _mm512_storeu_si512(c_row + j, mac_x32<frac_bits>(acc, wgt, a32));
+        }
+#endif
+#if defined(__AVX2__)
+        __m256i a16 = _mm256_set1_epi16(a);
+        for (; j + 16 <= N; j += 16) {
+          __m256i acc = _mm256_loadu_si256((const __m256i *)(c_row + j));
+          __m256i wgt = _mm256_loadu_si256((const __m256i *)(b_row + j));
+          _mm256_storeu_si256((__m256i *)(c_row + j), mac_x16<frac_bits>(acc, wgt, a16));
+        }
+#endif
+      }
+      for (; j < N; ++j) {
+        c_row[j] = mac<frac_bits>(c_row[j], b_row[j], a);
+      }
+    }
+  }
+}
+
+// C (M x N) = A (M x K) * B (K x N), rows split across hardware threads
+template <int frac_bits, typename T>
+inline void gemm(const T *A, const T *B, T *C, int M, int K, int N) {
+  int n_threads = std::max(1, std::min<int>(std::thread::hardware_concurrency(), M / 16));
+  if (n_threads == 1) {
+    gemm_rows<frac_bits>(A, B, C, K, N, 0, M);
+    return;
+  }
+  std::vector<std::thread> workers;
+  int rows_per = (M + n_threads - 1) / n_threads;
+  for (int t = 0; t < n_threads; ++t) {
+    int begin = t * rows_per, end = std::min(M, begin + rows_per);
+    if (begin < end) {
+      workers.emplace_back(gemm_rows<frac_bits, T>, A, B, C, K, N, begin, end);
+    }
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+}
+
+////////////////////////////////////// FIR //////////////////////////////////
+
+// out[n] = sum_t taps[t] * in[n - t], samples before in[0] are zero
+inline void fir(const int32_t *in, size_t n, const int32_t *taps, int n_taps, int32_t *out) {
+  // the first n_taps-1 outputs see the zero history, do those scalar
+  size_t head = std::min<size_t>(n, n_taps > 0 ? n_taps - 1 : 0);
+  for (size_t i = 0; i < head; ++i) {
+    uint32_t sum = 0;
+    for (int t = 0; t <= (int)i; ++t) {
+      sum += (uint32_t)taps[t] * (uint32_t)in[i - t];
+    }
+    out[i] = (int32_t)sum;
+  }
+  size_t i = head;
+#if defined(__AVX512F__)
+  for (; i + 16 <= n; i += 16) {
+    __m512i sum = _mm512_setzero_si512();
+    for (int t = 0; t < n_taps; ++t) {
+      __m512i x = _mm512_loadu_si512(in + i - t);
+      sum = _mm512_add_epi32(sum, _mm512_mullo_epi32(x, _mm512_set1_epi32(taps[t])));
+    }
+    _mm512_storeu_si512(out + i, sum);
+  }
+#endif
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    __m256i sum = _mm256_setzero_si256();
+    for (int t = 0; t < n_taps; ++t) {
+      __m256i x = _mm256_loadu_si256((const __m256i *)(in + i - t));
+      sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(x, _mm256_set1_epi32(taps[t])));
+    }
+    _mm256_storeu_si256((__m256i *)(out + i), sum);
+  }
+#endif
+  for (; i < n; ++i) {
+    uint32_t sum = 0;
+    for (int t = 0; t < n_taps; ++t) {
+      sum += (uint32_t)taps[t] * (uint32_t)in[i - t];
+    }
+    out[i] = (int32_t)sum;
+  }
+}
+
+inline std::vector<int> fir(const std::vector<int> &in, const std::vector<int> &taps) {
+  std::vector<int> out(in.size());
+  fir(in.data(), in.size(), taps.data(), (int)taps.size(), out.data());
+  return out;
+}
+
+/////////////////////////////////// vector add //////////////////////////////
+
+inline void vector_add(const int32_t *a, const int32_t *b, int32_t *out, size_t n) {
+  size_t i = 0;
+#if defined(__AVX512F__)
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_si512(out + i, _mm512_add_epi32(_mm512_loadu_si512(a + i),
+                                                  _mm512_loadu_si512(b + i)));
+  }
+#endif
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_si256((__m256i *)(out + i),
+                        _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                         _mm256_loadu_si256((const __m256i *)(b + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = (int32_t)((uint32_t)a[i] + (uint32_t)b[i]);
+  }
+}
+
+///////////////////////////////////// reduce ////////////////////////////////
+
+// op codes of object ReduceOp in src/main/scala/vector_dot/VectorReduce.scala
+enum reduce_op : int { dot = 0, sum = 1, min = 2, max = 3, sq_norm = 4 };
+
+// value of `op` over an empty vector, which is also what a core answers for one
+inline int64_t reduce_identity(int op) {
+  if (op == min) return INT64_MAX;
+  if (op == max) return INT64_MIN;
+  return 0;
+}
+
+inline int64_t reduce_combine(int op, int64_t x, int64_t y) {
+  if (op == min) return std::min(x, y);
+  if (op == max) return std::max(x, y);
+  return (int64_t)((uint64_t)x + (uint64_t)y);
+}
+
+// b is only read for dot
+inline int64_t reduce(int op, const int32_t *a, const int32_t *b, size_t n) {
+  uint64_t acc = (uint64_t)reduce_identity(op);
+  for (size_t i = 0; i < n; ++i) {
+    int64_t x = a[i];
+    switch (op) {
+    case dot: acc += (uint64_t)(x * b[i]); break;
+    case sum: acc += (uint64_t)x; break;
+    case sq_norm: acc += (uint64_t)(x * x); break;
+    default: acc = (uint64_t)reduce_combine(op, (int64_t)acc, x); break;
+    }
+  }
+  return (int64_t)acc;
+}
+
+} // namespace golden
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef BEETHOVEN_TEMPLATE_PERF_COUNTERS_H
+#define BEETHOVEN_TEMPLATE_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Host side of the per-core hardware performance counters (perf.PerfCounterBank).
+//
+// Every instrumented core answers read_counters(counter_id) with one 64-bit
+// counter and clears all of them on reset_counters. The generated commands
+// live in each core's own namespace, so snapshots take a callable that reads
+// one counter:
+//
+//   auto s = perf::read({"vec_a", "vec_b"}, [&](int id) {
+//     return myVectorAdd::read_counters(core, id).get().value;
+//   });
+//   s.print(stdout, "vector_add core 0");
+//
+// Cycle counts are only meaningful relative to total_cycles, which counts
+// every cycle since the last reset.
+
+namespace perf {
+
+// same layout as object PerfCounters in src/main/scala/perf/PerfCounters.scala
+enum counter : int {
+  total_cycles = 0,
+  busy_cycles = 1,
+  writer_stall_cycles = 2,
+  commands_completed = 3,
+  first_reader_stall = 4,
+};
+
+struct snapshot {
+  std::vector<uint64_t> values;
+  // one name per reader, in the order the core wires its reader stalls
+  std::vector<std::string> readers;
+
+  uint64_t operator[](int id) const {
+    return id < (int)values.size() ? values[id] : 0;
+  }
+
+  uint64_t reader_stall(int reader) const {
+    return (*this)[first_reader_stall + reader];
+  }
+
+  // share of total cycles spent in a counter's state
+  double percent(int id) const {
+    uint64_t total = (*this)[total_cycles];
+    return total ? 100.0 * (*this)[id] / total : 0.0;
+  }
+
+  // counters accumulated between two snapshots taken without a reset in between
+  snapshot operator-(const snapshot &earlier) const {
+    snapshot d{values, readers};
+    for (size_t i = 0; i < d.values.size() && i < earlier.values.size(); ++i) {
+      d.values[i] -= earlier.values[i];
+    }
+    return d;
+  }
+
+  void print(FILE *f, const char *label) const {
+    fprintf(f, "%s: %llu cycles, %llu commands, busy %.1f%%, writer stall %.1f%%", label,
+            (unsigned long long)(*this)[total_cycles], (unsigned long long)(*this)[commands_completed],
+            percent(busy_cycles), percent(writer_stall_cycles));
+    for (size_t r = 0; r < readers.size(); ++r) {
+      fprintf(f, ", %s stall %.1f%%", readers[r].c_str(), percent(first_reader_stall + (int)r));
+    }
+    fprintf(f, "\n");
+  }
+};
+
+template <typename Read>
+snapshot read(std::vector<std::string> readers, Read &&read_counter) {
+  snapshot s{{}, std::move(readers)};
+  int n = first_reader_stall + (int)s.readers.size();
+  for (int id = 0; id < n; ++id) {
+    s.values.push_back((uint64_t)read_counter(id));
+  }
+  return s;
+}
+
+} // namespace perf
+
+#endif
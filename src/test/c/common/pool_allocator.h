@@ -0,0 +1,198 @@
+#ifndef BEETHOVEN_TEMPLATE_POOL_ALLOCATOR_H
+#define BEETHOVEN_TEMPLATE_POOL_ALLOCATOR_H
+
+#include <beethoven/fpga_handle.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Size-class caching pool over fpga_handle_t::malloc.
+//
+// Requests are rounded up to a size class (four classes per power of two, so
+// at most 25% internal waste) and freed blocks are parked on that class's free
+// list instead of going back to the handle. A serving loop that allocates the
+// same shapes over and over therefore hits the free lists after warm-up and
+// never touches the underlying allocator.
+//
+// Blocks are never carved out of a larger allocation: copy_to_fpga and
+// copy_from_fpga move a remote_ptr's whole region, so neighbouring blocks
+// would clobber each other. reserve() pre-populates a class in bulk instead.
+//
+// A freed block is handed straight to the next allocation of its class, so
+// nothing may still point into its host side when it's freed; the Python
+// wrapper reference-counts each block and its NumPy views for that reason.
+
+namespace pool {
+using namespace beethoven;
+
+struct stats {
+  size_t bytes_in_use = 0;      // handed out to callers (class-rounded)
+  size_t bytes_cached = 0;      // parked on free lists
+  size_t high_water_mark = 0;   // max of bytes_in_use + bytes_cached
+  size_t peak_in_use = 0;       // max of bytes_in_use
+  size_t hits = 0;              // allocations served from a free list
+  size_t misses = 0;            // allocations that went to the handle
+};
+
+class pool_allocator {
+private:
+  static constexpr size_t min_block = 64;
+  static constexpr int classes_per_pow2 = 4;
+
+  fpga_handle_t &handle;
+  size_t max_cached_bytes;
+  std::mutex lock;
+  std::vector<std::vector<remote_ptr>> free_lists;
+  // fpga address -> size class of every block currently handed out
+  std::unordered_map<uint64_t, int> live;
+  stats counters;
+
+  static int size_class(size_t bytes) {
+    if (bytes <= min_block) {
+      return 0;
+    }
+    int log2 = 63 - __builtin_clzll(bytes - 1);  // floor(log2(bytes - 1))
+    size_t base = size_t(1) << log2;
+    int sub = (int)((bytes - 1 - base) / (base / classes_per_pow2));
+    return (log2 - 6) * classes_per_pow2 + sub + 1;
+  }
+
+  static size_t class_bytes(int cls) {
+    if (cls == 0) {
+      return min_block;
+    }
+    int log2 = (cls - 1) / classes_per_pow2 + 6;
+    int sub = (cls - 1) % classes_per_pow2;
+    size_t base = size_t(1) << log2;
+    return base + (sub + 1) * (base / classes_per_pow2);
+  }
+
+  void update_peaks() {
+    if (counters.bytes_in_use > counters.peak_in_use) {
+      counters.peak_in_use = counters.bytes_in_use;
+    }
+    size_t footprint = counters.bytes_in_use + counters.bytes_cached;
+    if (footprint > counters.high_water_mark) {
+      counters.high_water_mark = footprint;
+    }
+  }
+
+  std::vector<remote_ptr> &free_list(int cls) {
+    if ((int)free_lists.size() <= cls) {
+      free_lists.resize(cls + 1);
+    }
+    return free_lists[cls];
+  }
+
+public:
+  // max_cached_bytes caps how much freed memory is kept around for reuse
+  explicit pool_allocator(fpga_handle_t &handle, size_t max_cached_bytes = size_t(1) << 30)
+      : handle(handle), max_cached_bytes(max_cached_bytes) {}
+
+  pool_allocator(const pool_allocator &) = delete;
+  pool_allocator &operator=(const pool_allocator &) = delete;
+
+  ~pool_allocator() { trim(); }
+
+  remote_ptr malloc(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    int cls = size_class(bytes);
+    auto &list = free_list(cls);
+    remote_ptr block;
+    if (!list.empty()) {
+      block = list.back();
+      list.pop_back();
+      counters.bytes_cached -= class_bytes(cls);
+      ++counters.hits;
+    } else {
+      block = handle.malloc(class_bytes(cls));
+      ++counters.misses;
+    }
+    live[block.getFpgaAddr()] = cls;
+    counters.bytes_in_use += class_bytes(cls);
+    update_peaks();
+    return block;
+  }
+
+  // return a block to its free list (or to the handle if the cache is full);
+  // freeing something this pool didn't hand out is a no-op
+  void free(const remote_ptr &block) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = live.find(block.getFpgaAddr());
+    if (it == live.end()) {
+      return;
+    }
+    int cls = it->second;
+    live.erase(it);
+    counters.bytes_in_use -= class_bytes(cls);
+    if (counters.bytes_cached + class_bytes(cls) > max_cached_bytes) {
+      handle.free(block);
+      return;
+    }
+    free_list(cls).push_back(block);
+    counters.bytes_cached += class_bytes(cls);
+  }
+
+  // pre-populate the class for `bytes` so the next `count` allocations hit
+  void reserve(size_t bytes, int count) {
+    std::lock_guard<std::mutex> guard(lock);
+    int cls = size_class(bytes);
+    auto &list = free_list(cls);
+    for (int i = 0; i < count; ++i) {
+      list.push_back(handle.malloc(class_bytes(cls)));
+      counters.bytes_cached += class_bytes(cls);
+    }
+    update_peaks();
+  }
+
+  // hand every cached block back to the handle
+  void trim() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &list : free_lists) {
+      for (auto &block : list) {
+        handle.free(block);
+      }
+      list.clear();
+    }
+    counters.bytes_cached = 0;
+  }
+
+  stats get_stats() {
+    std::lock_guard<std::mutex> guard(lock);
+    return counters;
+  }
+
+  fpga_handle_t &get_handle() { return handle; }
+
+  // Scoped scratch allocations: everything allocated through an arena goes
+  // back to the pool when the arena is destroyed.
+  class arena {
+  private:
+    pool_allocator &parent;
+    std::vector<remote_ptr> blocks;
+
+  public:
+    explicit arena(pool_allocator &parent) : parent(parent) {}
+    arena(const arena &) = delete;
+    arena &operator=(const arena &) = delete;
+    ~arena() { release(); }
+
+    remote_ptr malloc(size_t bytes) {
+      blocks.push_back(parent.malloc(bytes));
+      return blocks.back();
+    }
+
+    void release() {
+      for (auto &block : blocks) {
+        parent.free(block);
+      }
+      blocks.clear();
+    }
+  };
+};
+
+} // namespace pool
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef BEETHOVEN_TEMPLATE_TRACE_H
+#define BEETHOVEN_TEMPLATE_TRACE_H
+
+#include <beethoven/fpga_handle.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Opt-in timeline tracing of host <-> accelerator operations.
+//
+// Wrap handle operations and command issues with the helpers below. While
+// tracing is off, each helper costs one relaxed atomic load before calling
+// straight through; define BEETHOVEN_TRACE_DISABLE to compile even that out.
+// While tracing is on, every operation becomes an event with a timestamp,
+// duration, core ID and byte count, buffered per thread, and write() dumps
+// them as Chrome trace JSON (chrome://tracing or ui.perfetto.dev):
+//   - process "host": malloc / copies / response waits, one track per thread
+//   - process "cores": each command from issue until the host collects its
+//     response with get(), with its core in the args. Spans end at host
+//     retirement, not when the core finishes, so a span includes any time
+//     the response sat unread, and gaps between a core's spans aren't
+//     necessarily idle core time. Commands in flight together overlap, so
+//     they're written as async events, which the viewers lay out side by
+//     side instead of nesting.
+//
+// Set BEETHOVEN_TRACE=<file.json> and call init_from_env() to trace a whole
+// run and write the file at exit.
+
+namespace trace {
+using namespace beethoven;
+using trace_clock = std::chrono::steady_clock;
+
+struct event {
+  const char *name;
+  double ts_us, dur_us;
+  int core;       // -1 for host-only operations
+  size_t bytes;
+  bool on_core;   // command span on the core's track
+  int thread;
+};
+
+struct thread_buffer {
+  int thread;
+  std::vector<event> events;
+};
+
+struct state {
+  std::atomic<bool> enabled{false};
+  trace_clock::time_point epoch = trace_clock::now();
+  std::mutex lock;
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+};
+
+inline state &global() {
+  static state s;
+  return s;
+}
+
+inline bool enabled() {
+#ifdef BEETHOVEN_TRACE_DISABLE
+  return false;
+#else
+  return global().enabled.load(std::memory_order_relaxed);
+#endif
+}
+
+inline double now_us() {
+  return std::chrono::duration<double, std::micro>(trace_clock::now() - global().epoch).count();
+}
+
+inline thread_buffer &local_buffer() {
+  thread_local std::shared_ptr<thread_buffer> buf = [] {
+    auto &g = global();
+    std::lock_guard<std::mutex> guard(g.lock);
+    auto b = std::make_shared<thread_buffer>();
+    b->thread = (int)g.buffers.size();
+    g.buffers.push_back(b);
+    return b;
+  }();
+  return *buf;
+}
+
+inline void record(const char *name, double start_us, int core, size_t bytes, bool on_core = false) {
+  auto &buf = local_buffer();
+  buf.events.push_back(event{name, start_us, now_us() - start_us, core, bytes, on_core, buf.thread});
+}
+
+inline void start() {
+  global().enabled.store(true, std::memory_order_relaxed);
+}
+
+inline void stop() {
+  global().enabled.store(false, std::memory_order_relaxed);
+}
+
+// Dump everything recorded so far. Call once the traced threads are quiet.
+inline bool write(const char *path) {
+  auto &g = global();
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(g.lock);
+  fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"args\": {\"name\": \"host\"}},\n");
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"cores\"}}");
+  int command_id = 0;
+  for (auto &buf : g.buffers) {
+    for (auto &e : buf->events) {
+      if (!e.on_core) {
+        fprintf(f,
+                ",\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, "
+                "\"tid\": %d, \"args\": {\"core\": %d, \"bytes\": %zu}}",
+                e.name, e.ts_us, e.dur_us, e.thread, e.core, e.bytes);
+        continue;
+      }
+      // a begin/end pair per command, tied together by id
+      fprintf(f,
+              ",\n{\"name\": \"%s\", \"cat\": \"command\", \"ph\": \"b\", \"id\": %d, "
+              "\"ts\": %.3f, \"pid\": 1, \"tid\": %d, \"args\": {\"core\": %d, \"bytes\": %zu}}"
+              ",\n{\"name\": \"%s\", \"cat\": \"command\", \"ph\": \"e\", \"id\": %d, "
+              "\"ts\": %.3f, \"pid\": 1, \"tid\": %d}",
+              e.name, command_id, e.ts_us, e.core, e.core, e.bytes, e.name, command_id,
+              e.ts_us + e.dur_us, e.core);
+      ++command_id;
+    }
+  }
+  fprintf(f, "\n]}\n");
+  fclose(f);
+  return true;
+}
+
+inline void init_from_env() {
+  static const char *path = std::getenv("BEETHOVEN_TRACE");
+  if (path && *path) {
+    start();
+    std::atexit([] {
+      if (!write(path)) {
+        fprintf(stderr, "Failed to write trace to %s\n", path);
+      }
+    });
+  }
+}
+
+// RAII span for arbitrary host work
+class scope {
+private:
+  const char *name;
+  int core;
+  size_t bytes;
+  double start_us;
+  bool active;
+
+public:
+  scope(const char *name, int core = -1, size_t bytes = 0)
+      : name(name), core(core), bytes(bytes), active(enabled()) {
+    if (active) {
+      start_us = now_us();
+    }
+  }
+  ~scope() {
+    if (active) {
+      record(name, start_us, core, bytes);
+    }
+  }
+};
+
+inline remote_ptr malloc(fpga_handle_t &handle, size_t bytes) {
+  scope s("malloc", -1, bytes);
+  return handle.malloc(bytes);
+}
+
+inline void copy_to_fpga(fpga_handle_t &handle, const remote_ptr &p) {
+  scope s("copy_to_fpga", -1, p.getLen());
+  handle.copy_to_fpga(p);
+}
+
+inline void copy_from_fpga(fpga_handle_t &handle, const remote_ptr &p) {
+  scope s("copy_from_fpga", -1, p.getLen());
+  handle.copy_from_fpga(p);
+}
+
+// A response handle that remembers when its command was issued. get()
+// records the host-side wait and the command's span from issue to this get().
+template <typename Response>
+class traced {
+private:
+  Response resp;
+  const char *name;
+  int core;
+  size_t bytes;
+  double issue_us;
+  bool active;
+
+public:
+  traced(Response resp, const char *name, int core, size_t bytes, double issue_us, bool active)
+      : resp(std::move(resp)), name(name), core(core), bytes(bytes), issue_us(issue_us),
+        active(active) {}
+
+  auto get() {
+    if (!active) {
+      return resp.get();
+    }
+    double wait_us = now_us();
+    auto result = resp.get();
+    record("response_wait", wait_us, core, bytes);
+    record(name, issue_us, core, bytes, true);
+    return result;
+  }
+};
+
+// trace::issue("matmul", core, bytes, [&] { return SystolicArrayCore::matmul(core, ...); })
+template <typename Issue>
+auto issue(const char *name, int core, size_t bytes, Issue &&do_issue) {
+  bool active = enabled();
+  double issue_us = active ? now_us() : 0;
+  auto resp = do_issue();
+  if (active) {
+    record("issue", issue_us, core, bytes);
+  }
+  return traced<decltype(resp)>(std::move(resp), name, core, bytes, issue_us, active);
+}
+
+} // namespace trace
+
+#endif
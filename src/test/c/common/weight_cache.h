@@ -0,0 +1,215 @@
+#ifndef BEETHOVEN_TEMPLATE_WEIGHT_CACHE_H
+#define BEETHOVEN_TEMPLATE_WEIGHT_CACHE_H
+
+#include <beethoven/fpga_handle.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "trace.h"
+
+// Device-resident cache for buffers that are uploaded over and over with the
+// same contents, e.g. the weights of a model serving many requests.
+//
+// Entries are looked up by key: either a user-chosen name, or content_key()
+// of the source data (a 64-bit hash plus the length). On a miss the cache
+// mallocs the buffer, lets the caller fill the host side (so packed layouts
+// can be cached under the key of the unpacked data), and copies it to the
+// device. On a hit it returns the resident buffer with no copy at all.
+//
+// The total size of the entries is kept under a budget by evicting the least
+// recently used ones. An entry acquire()d by a caller is pinned until the
+// matching release() and is never evicted; if pinned entries alone exceed
+// the budget the cache goes over it and catches up on the next release().
+// All members are thread-safe.
+
+namespace cache {
+using namespace beethoven;
+
+struct stats {
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t evictions = 0;
+  size_t bytes_uploaded = 0;
+  size_t bytes_resident = 0;
+  size_t entries = 0;
+};
+
+// 64-bit content hash, 8 bytes per step
+inline uint64_t hash_bytes(const void *data, size_t bytes, uint64_t seed = 0) {
+  const uint64_t mul = 0x9E3779B97F4A7C15ull;
+  auto mix = [](uint64_t x) {
+    x ^= x >> 31;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 29;
+    return x;
+  };
+  uint64_t h = seed ^ (bytes * mul);
+  auto *p = (const unsigned char *)data;
+  size_t words = bytes / 8;
+  for (size_t i = 0; i < words; ++i) {
+    uint64_t w;
+    std::memcpy(&w, p + 8 * i, 8);
+    h = (h ^ mix(w)) * mul;
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, p + 8 * words, bytes % 8);
+  h = (h ^ mix(tail)) * mul;
+  return mix(h);
+}
+
+// key for a buffer identified by its contents; salt tells apart different
+// layouts (e.g. shapes) of the same bytes
+inline std::string content_key(const void *data, size_t bytes, uint64_t salt = 0) {
+  char key[64];
+  snprintf(key, sizeof(key), "#%016llx:%zu", (unsigned long long)hash_bytes(data, bytes, salt),
+           bytes);
+  return key;
+}
+
+class weight_cache {
+private:
+  struct entry {
+    remote_ptr buf;
+    size_t bytes;
+    int pins;
+    std::list<std::string>::iterator lru_pos;
+  };
+
+  fpga_handle_t &handle;
+  size_t budget;
+  std::mutex lock;
+  std::unordered_map<std::string, entry> entries;
+  std::list<std::string> lru;  // most recently used at the front
+  stats st;
+
+  // evict unpinned entries, oldest first, until `incoming` more bytes fit
+  void make_room(size_t incoming) {
+    auto it = lru.end();
+    while (st.bytes_resident + incoming > budget && it != lru.begin()) {
+      --it;
+      auto e = entries.find(*it);
+      if (e->second.pins > 0) {
+        continue;
+      }
+      handle.free(e->second.buf);
+      st.bytes_resident -= e->second.bytes;
+      st.evictions++;
+      entries.erase(e);
+      it = lru.erase(it);
+    }
+  }
+
+  template <typename Fill>
+  entry &lookup(const std::string &key, size_t bytes, Fill &fill) {
+    auto found = entries.find(key);
+    if (found != entries.end()) {
+      if (found->second.bytes != bytes) {
+        throw std::runtime_error("Weight cache key reused with a different size");
+      }
+      st.hits++;
+      lru.splice(lru.begin(), lru, found->second.lru_pos);
+      return found->second;
+    }
+    st.misses++;
+    make_room(bytes);
+    auto buf = trace::malloc(handle, bytes);
+    fill(buf.getHostAddr());
+    trace::copy_to_fpga(handle, buf);
+    st.bytes_uploaded += bytes;
+    st.bytes_resident += bytes;
+    lru.push_front(key);
+    return entries[key] = entry{buf, bytes, 0, lru.begin()};
+  }
+
+public:
+  weight_cache(fpga_handle_t &handle, size_t budget_bytes) : handle(handle), budget(budget_bytes) {}
+
+  weight_cache(const weight_cache &) = delete;
+  weight_cache &operator=(const weight_cache &) = delete;
+
+  ~weight_cache() {
+    for (auto &e : entries) {
+      handle.free(e.second.buf);
+    }
+  }
+
+  // Resident buffer for key, uploading it on a miss: fill(void *host) writes
+  // the `bytes` bytes that get copied to the device. The buffer may be
+  // evicted by a later miss; use acquire() to hold on to it.
+  template <typename Fill>
+  remote_ptr get(const std::string &key, size_t bytes, Fill &&fill) {
+    std::lock_guard<std::mutex> guard(lock);
+    return lookup(key, bytes, fill).buf;
+  }
+
+  remote_ptr get(const std::string &key, const void *data, size_t bytes) {
+    return get(key, bytes, [&](void *dst) { std::memcpy(dst, data, bytes); });
+  }
+
+  // keyed by content
+  remote_ptr get(const void *data, size_t bytes) {
+    return get(content_key(data, bytes), data, bytes);
+  }
+
+  // like get(), but the entry stays resident until release(key)
+  template <typename Fill>
+  remote_ptr acquire(const std::string &key, size_t bytes, Fill &&fill) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto &e = lookup(key, bytes, fill);
+    e.pins++;
+    return e.buf;
+  }
+
+  void release(const std::string &key) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = entries.find(key);
+    if (found == entries.end() || found->second.pins == 0) {
+      throw std::runtime_error("Weight cache release without acquire");
+    }
+    found->second.pins--;
+    make_room(0);
+  }
+
+  bool contains(const std::string &key) {
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.count(key) != 0;
+  }
+
+  // drop an entry, e.g. after its source weights changed under a user key
+  void erase(const std::string &key) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = entries.find(key);
+    if (found == entries.end()) {
+      return;
+    }
+    if (found->second.pins > 0) {
+      throw std::runtime_error("Cannot erase a pinned weight cache entry");
+    }
+    handle.free(found->second.buf);
+    st.bytes_resident -= found->second.bytes;
+    lru.erase(found->second.lru_pos);
+    entries.erase(found);
+  }
+
+  void set_budget(size_t budget_bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    budget = budget_bytes;
+    make_room(0);
+  }
+
+  stats get_stats() {
+    std::lock_guard<std::mutex> guard(lock);
+    stats s = st;
+    s.entries = entries.size();
+    return s;
+  }
+};
+
+} // namespace cache
+
+#endif
@@ -0,0 +1,30 @@
+# Stand-ins for the Beethoven CMake functions that build host programs against
+# the functional emulation backend in this directory (beethoven/fpga_handle.h,
+# beethoven_hardware.h) instead of an RTL simulation or an FPGA. Included by
+# the CMakeLists when BEETHOVEN_EMULATION is ON; no Beethoven install needed.
+
+set(BEETHOVEN_EMULATION_DIR ${CMAKE_CURRENT_LIST_DIR})
+find_package(Threads REQUIRED)
+
+# nothing to elaborate: the emulated cores are compiled into the host program
+function(beethoven_hardware name)
+endfunction()
+
+function(link_beethoven_to_target target)
+  target_include_directories(${target} PRIVATE ${BEETHOVEN_EMULATION_DIR})
+  target_compile_definitions(${target} PRIVATE BEETHOVEN_EMULATION)
+  target_link_libraries(${target} PRIVATE Threads::Threads)
+endfunction()
+
+function(beethoven_build name)
+  cmake_parse_arguments(ARG "" "" "SOURCES" ${ARGN})
+  add_executable(${name} ${ARG_SOURCES})
+  link_beethoven_to_target(${name})
+endfunction()
+
+# HARDWARE and SIMULATOR are accepted and ignored
+function(beethoven_testbench name)
+  cmake_parse_arguments(ARG "" "HARDWARE;SIMULATOR" "SOURCES" ${ARGN})
+  add_executable(${name} ${ARG_SOURCES})
+  link_beethoven_to_target(${name})
+endfunction()
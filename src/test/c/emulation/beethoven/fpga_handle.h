@@ -0,0 +1,186 @@
+#ifndef BEETHOVEN_EMULATION_FPGA_HANDLE_H
+#define BEETHOVEN_EMULATION_FPGA_HANDLE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+
+// Functional emulation of the Beethoven runtime (fpga_handle_t, remote_ptr,
+// response_handle), used instead of the real runtime when the host code is
+// built with -DBEETHOVEN_EMULATION=ON. The emulated cores themselves are in
+// ../beethoven_hardware.h.
+//
+// Every allocation has a host buffer and a separate device buffer, and only
+// copy_to_fpga / copy_from_fpga move data between them, so host code that
+// forgets a copy fails here the way it would on a PCIe-attached FPGA. Device
+// addresses are the device buffers' own addresses, so the models read and
+// write them directly.
+//
+// Each (system, core) pair gets a worker thread that runs its commands in
+// issue order, like a core's command queue; different cores run in parallel.
+
+namespace beethoven {
+
+class remote_ptr {
+private:
+  uint64_t fpga_addr = 0;
+  void *host_addr = nullptr;
+  size_t len = 0;
+
+public:
+  remote_ptr() = default;
+  remote_ptr(uint64_t fpga_addr, void *host_addr, size_t len)
+      : fpga_addr(fpga_addr), host_addr(host_addr), len(len) {}
+
+  uint64_t getFpgaAddr() const { return fpga_addr; }
+  void *getHostAddr() const { return host_addr; }
+  size_t getLen() const { return len; }
+
+  // the segment starting `offset` bytes in
+  remote_ptr operator+(size_t offset) const {
+    return remote_ptr(fpga_addr + offset, (char *)host_addr + offset,
+                      offset < len ? len - offset : 0);
+  }
+};
+
+template <typename T>
+class response_handle {
+private:
+  std::shared_future<T> result;
+
+public:
+  response_handle() = default;
+  explicit response_handle(std::shared_future<T> result) : result(std::move(result)) {}
+
+  // blocks until the command has run; rethrows if the model threw
+  T get() { return result.get(); }
+
+  std::optional<T> try_get() {
+    if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return std::nullopt;
+    }
+    return result.get();
+  }
+};
+
+namespace emulation {
+
+// runs one core's commands in order on its own thread
+class core_worker {
+private:
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> queue;
+  bool stopping = false;
+  std::thread thread;
+
+  void run() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        cv.wait(guard, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+          return;
+        }
+        job = std::move(queue.front());
+        queue.pop_front();
+      }
+      job();
+    }
+  }
+
+public:
+  core_worker() : thread([this] { run(); }) {}
+
+  ~core_worker() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  void push(std::function<void()> job) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      queue.push_back(std::move(job));
+    }
+    cv.notify_one();
+  }
+};
+
+inline core_worker &worker(const std::string &system, int core) {
+  static std::mutex lock;
+  static std::map<std::pair<std::string, int>, std::unique_ptr<core_worker>> workers;
+  std::lock_guard<std::mutex> guard(lock);
+  auto &w = workers[{system, core}];
+  if (!w) {
+    w = std::make_unique<core_worker>();
+  }
+  return *w;
+}
+
+// queue a command on a core; the handle resolves to what the model returns
+template <typename T, typename Model>
+response_handle<T> submit(const std::string &system, int core, Model &&model) {
+  auto task = std::make_shared<std::packaged_task<T()>>(std::forward<Model>(model));
+  response_handle<T> handle(task->get_future().share());
+  worker(system, core).push([task] { (*task)(); });
+  return handle;
+}
+
+} // namespace emulation
+
+class fpga_handle_t {
+private:
+  static constexpr size_t alignment = 64;
+
+  static void *alloc(size_t len) {
+    size_t bytes = (len + alignment - 1) / alignment * alignment;
+    void *p = std::aligned_alloc(alignment, bytes ? bytes : alignment);
+    if (!p) {
+      throw std::runtime_error("Emulated FPGA out of memory");
+    }
+    std::memset(p, 0, bytes);
+    return p;
+  }
+
+public:
+  remote_ptr malloc(size_t len) {
+    void *device = alloc(len);
+    return remote_ptr((uint64_t)device, alloc(len), len);
+  }
+
+  void free(remote_ptr p) {
+    std::free((void *)p.getFpgaAddr());
+    std::free(p.getHostAddr());
+  }
+
+  void copy_to_fpga(const remote_ptr &p) {
+    std::memcpy((void *)p.getFpgaAddr(), p.getHostAddr(), p.getLen());
+  }
+
+  void copy_from_fpga(const remote_ptr &p) {
+    std::memcpy(p.getHostAddr(), (const void *)p.getFpgaAddr(), p.getLen());
+  }
+
+  void shutdown() const {}
+};
+
+} // namespace beethoven
+
+#endif
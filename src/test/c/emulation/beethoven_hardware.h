@@ -0,0 +1,453 @@
+#ifndef BEETHOVEN_EMULATION_HARDWARE_H
+#define BEETHOVEN_EMULATION_HARDWARE_H
+
+#include <beethoven/fpga_handle.h>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "../common/golden.h"
+
+// Functional models of the template's cores behind the same API Beethoven
+// generates for them, for host code built with -DBEETHOVEN_EMULATION=ON.
+//
+// Every model is bit-exact with its RTL (the arithmetic is shared with the
+// golden models) and keeps the per-core state the hardware keeps between
+// commands: the systolic array accumulators across matmul_partial / flush,
+// the FIR taps and window history. There is no timing model, so the
+// performance counters only count completed commands; the cycle counters
+// read 0.
+//
+// The configuration defaults to what the Scala builds export; pass -D flags
+// (e.g. -DSYSTOLIC_ARRAY_N_CORES=4) to emulate a different build.
+
+#ifndef SYSTOLIC_ARRAY_DIM
+#define SYSTOLIC_ARRAY_DIM 8
+#endif
+#ifndef SYSTOLIC_ARRAY_N_CORES
+#define SYSTOLIC_ARRAY_N_CORES 1
+#endif
+#ifndef SYSTOLIC_ARRAY_CONV_CHANNELS
+#define SYSTOLIC_ARRAY_CONV_CHANNELS 512
+#endif
+#ifndef SYSTOLIC_ARRAY_SPARSE
+#define SYSTOLIC_ARRAY_SPARSE 1
+#endif
+#ifndef DATA_WIDTH_BYTES
+#define DATA_WIDTH_BYTES 2
+#endif
+#ifndef FRAC_BITS
+#define FRAC_BITS (4 * DATA_WIDTH_BYTES)
+#endif
+#ifndef INT_BITS
+#define INT_BITS (8 * DATA_WIDTH_BYTES - FRAC_BITS - 1)
+#endif
+#ifndef VECTOR_ADD_N_CORES
+#define VECTOR_ADD_N_CORES 3
+#endif
+#ifndef VECTOR_ADD_LANES
+#define VECTOR_ADD_LANES 16
+#endif
+#ifndef VECTOR_DOT_N_CORES
+#define VECTOR_DOT_N_CORES 3
+#endif
+#ifndef VECTOR_DOT_LANES
+#define VECTOR_DOT_LANES 16
+#endif
+#ifndef FIR_N_CORES
+#define FIR_N_CORES 3
+#endif
+#ifndef ACCEL_WINDOW_SIZE
+#define ACCEL_WINDOW_SIZE 4
+#endif
+
+namespace beethoven {
+namespace emulation {
+
+// same layout as object PerfCounters in src/main/scala/perf/PerfCounters.scala
+struct perf_counters {
+  static constexpr int commands_completed = 3;
+  uint64_t completed = 0;
+
+  uint64_t read(int id) const { return id == commands_completed ? completed : 0; }
+};
+
+// Per-core state of one system. Only touched by that core's worker thread.
+template <typename State, int n_cores>
+State &core_state(int core) {
+  static State states[n_cores];
+  if (core < 0 || core >= n_cores) {
+    throw std::runtime_error("Emulated command sent to a core that doesn't exist");
+  }
+  return states[core];
+}
+
+} // namespace emulation
+} // namespace beethoven
+
+// the counter commands every instrumented core answers
+#define BEETHOVEN_EMULATED_COUNTERS(system, state)                                               \
+  struct counter_value {                                                                       \
+    uint64_t value;                                                                            \
+  };                                                                                           \
+  inline beethoven::response_handle<counter_value> read_counters(int16_t core_id,              \
+                                                                 uint8_t counter_id) {         \
+    return beethoven::emulation::submit<counter_value>(system, core_id, [=] {                  \
+      return counter_value{state(core_id).counters.read(counter_id)};                          \
+    });                                                                                        \
+  }                                                                                            \
+  inline beethoven::response_handle<bool> reset_counters(int16_t core_id) {                   \
+    return beethoven::emulation::submit<bool>(system, core_id, [=] {                           \
+      state(core_id).counters = {};                                                            \
+      return true;                                                                             \
+    });                                                                                        \
+  }
+
+//////////////////////////////// systolic array ///////////////////////////////
+
+namespace SystolicArrayCore {
+namespace detail {
+
+using element = std::conditional_t<DATA_WIDTH_BYTES == 1, int8_t,
+                                   std::conditional_t<DATA_WIDTH_BYTES == 2, int16_t, int32_t>>;
+constexpr int dim = SYSTOLIC_ARRAY_DIM;
+
+struct state {
+  // accumulators[j * dim + i] is PE (i, j), in the order a tile is written out
+  element accumulators[dim * dim] = {};
+  beethoven::emulation::perf_counters counters;
+};
+
+inline state &core(int core_id) {
+  return beethoven::emulation::core_state<state, SYSTOLIC_ARRAY_N_CORES>(core_id);
+}
+
+// stream inner_dimension beats through the array, like ProcessingElement.v
+inline void multiply(state &s, uint64_t act_addr, uint32_t inner_dimension, uint64_t wgt_addr) {
+  auto *act = (const element *)act_addr, *wgt = (const element *)wgt_addr;
+  for (uint32_t k = 0; k < inner_dimension; ++k) {
+    for (int j = 0; j < dim; ++j) {
+      for (int i = 0; i < dim; ++i) {
+        auto &acc = s.accumulators[j * dim + i];
+        acc = golden::mac<FRAC_BITS>(acc, wgt[k * dim + j], act[k * dim + i]);
+      }
+    }
+  }
+}
+
+// the zero-product MACs of `gap` skipped slices, the way ProcessingElement
+// catches up: once for an odd count, twice for an even one
+inline void skip_slices(state &s, uint32_t gap) {
+  for (uint32_t z = 0; gap && z < 2 - (gap & 1); ++z) {
+    for (auto &acc : s.accumulators) {
+      acc = golden::mac<FRAC_BITS>(acc, element(0), element(0));
+    }
+  }
+}
+
+// shifting the tile out leaves the accumulators zeroed
+inline void write_back(state &s, uint64_t out_addr) {
+  std::memcpy((void *)out_addr, s.accumulators, sizeof(s.accumulators));
+  std::memset(s.accumulators, 0, sizeof(s.accumulators));
+}
+
+} // namespace detail
+
+inline beethoven::response_handle<bool> matmul(int16_t core_id, uint64_t act_addr,
+                                               uint32_t inner_dimension, uint64_t out_addr,
+                                               uint64_t wgt_addr) {
+  return beethoven::emulation::submit<bool>("SystolicArrayCore", core_id, [=] {
+    auto &s = detail::core(core_id);
+    std::memset(s.accumulators, 0, sizeof(s.accumulators));
+    detail::multiply(s, act_addr, inner_dimension, wgt_addr);
+    detail::write_back(s, out_addr);
+    s.counters.completed++;
+    return true;
+  });
+}
+
+inline beethoven::response_handle<bool> matmul_partial(int16_t core_id, bool accumulate,
+                                                       uint64_t act_addr, uint32_t inner_dimension,
+                                                       uint64_t wgt_addr) {
+  return beethoven::emulation::submit<bool>("SystolicArrayCore", core_id, [=] {
+    auto &s = detail::core(core_id);
+    if (!accumulate) {
+      std::memset(s.accumulators, 0, sizeof(s.accumulators));
+    }
+    detail::multiply(s, act_addr, inner_dimension, wgt_addr);
+    s.counters.completed++;
+    return true;
+  });
+}
+
+inline beethoven::response_handle<bool> flush(int16_t core_id, uint64_t out_addr) {
+  return beethoven::emulation::submit<bool>("SystolicArrayCore", core_id, [=] {
+    auto &s = detail::core(core_id);
+    detail::write_back(s, out_addr);
+    s.counters.completed++;
+    return true;
+  });
+}
+
+// only the occupied slices reach the array, tagged with the gaps before them
+inline beethoven::response_handle<bool> matmul_sparse(int16_t core_id, uint64_t act_addr,
+                                                      uint32_t inner_dimension, uint32_t n_slices,
+                                                      uint64_t occupancy_addr, uint64_t out_addr,
+                                                      uint64_t wgt_addr) {
+  return beethoven::emulation::submit<bool>("SystolicArrayCore", core_id, [=] {
+    using detail::dim;
+    auto *occupancy = (const uint32_t *)occupancy_addr;
+    auto &s = detail::core(core_id);
+    std::memset(s.accumulators, 0, sizeof(s.accumulators));
+    uint32_t gap = 0, stored = 0;
+    for (uint32_t k = 0; k < inner_dimension; ++k) {
+      if (!((occupancy[k / 32] >> (k % 32)) & 1)) {
+        ++gap;
+        continue;
+      }
+      if (stored == n_slices) {
+        throw std::runtime_error("matmul_sparse occupancy has more slices than n_slices");
+      }
+      detail::skip_slices(s, gap);
+      gap = 0;
+      detail::multiply(s, act_addr + k * dim * sizeof(detail::element), 1,
+                       wgt_addr + stored++ * dim * sizeof(detail::element));
+    }
+    if (stored != n_slices || n_slices == 0) {
+      throw std::runtime_error("matmul_sparse n_slices doesn't match the occupancy");
+    }
+    detail::skip_slices(s, gap);
+    detail::write_back(s, out_addr);
+    s.counters.completed++;
+    return true;
+  });
+}
+
+// the activation panel Im2colStream generates for one conv tile
+inline beethoven::response_handle<bool> conv(int16_t core_id, uint16_t channels,
+                                             uint8_t dilation_h, uint8_t dilation_w,
+                                             uint16_t in_height, uint16_t in_width,
+                                             uint64_t input_addr, uint8_t kernel_height,
+                                             uint8_t kernel_width, uint8_t n_pixels,
+                                             uint64_t out_addr, uint16_t out_col, uint16_t out_row,
+                                             uint16_t out_width, uint8_t pad_h, uint8_t pad_w,
+                                             uint8_t stride_h, uint8_t stride_w,
+                                             uint64_t wgt_addr) {
+  if (channels == 0 || channels % detail::dim != 0 || channels > SYSTOLIC_ARRAY_CONV_CHANNELS) {
+    throw std::runtime_error("conv channels must be a non-zero multiple of SYSTOLIC_ARRAY_DIM "
+                             "up to SYSTOLIC_ARRAY_CONV_CHANNELS");
+  }
+  return beethoven::emulation::submit<bool>("SystolicArrayCore", core_id, [=] {
+    using detail::dim;
+    auto *input = (const detail::element *)input_addr;
+    uint32_t K = uint32_t(kernel_height) * kernel_width * channels;
+    std::vector<detail::element> act((size_t)K * dim, 0);
+    for (int i = 0; i < dim && i < n_pixels; ++i) {
+      int oy = out_row + (out_col + i) / out_width, ox = (out_col + i) % out_width;
+      for (int ky = 0; ky < kernel_height; ++ky) {
+        int iy = oy * stride_h - pad_h + ky * dilation_h;
+        for (int kx = 0; kx < kernel_width; ++kx) {
+          int ix = ox * stride_w - pad_w + kx * dilation_w;
+          if (iy < 0 || iy >= in_height || ix < 0 || ix >= in_width) {
+            continue;
+          }
+          size_t k0 = size_t(ky * kernel_width + kx) * channels;
+          const auto *pixel = input + ((size_t)iy * in_width + ix) * channels;
+          for (int c = 0; c < channels; ++c) {
+            act[(k0 + c) * dim + i] = pixel[c];
+          }
+        }
+      }
+    }
+    auto &s = detail::core(core_id);
+    std::memset(s.accumulators, 0, sizeof(s.accumulators));
+    detail::multiply(s, (uint64_t)act.data(), K, wgt_addr);
+    detail::write_back(s, out_addr);
+    s.counters.completed++;
+    return true;
+  });
+}
+
+BEETHOVEN_EMULATED_COUNTERS("SystolicArrayCore", detail::core)
+
+} // namespace SystolicArrayCore
+
+///////////////////////////////// vector add //////////////////////////////////
+
+namespace myVectorAdd {
+namespace detail {
+
+struct state {
+  beethoven::emulation::perf_counters counters;
+};
+
+inline state &core(int core_id) {
+  return beethoven::emulation::core_state<state, VECTOR_ADD_N_CORES>(core_id);
+}
+
+} // namespace detail
+
+inline beethoven::response_handle<bool> vector_add(int16_t core_id,
+                                                   const beethoven::remote_ptr &vec_a_addr,
+                                                   const beethoven::remote_ptr &vec_b_addr,
+                                                   const beethoven::remote_ptr &vec_out_addr,
+                                                   uint32_t vector_length) {
+  uint64_t a = vec_a_addr.getFpgaAddr(), b = vec_b_addr.getFpgaAddr();
+  uint64_t out = vec_out_addr.getFpgaAddr();
+  return beethoven::emulation::submit<bool>("myVectorAdd", core_id, [=] {
+    golden::vector_add((const int32_t *)a, (const int32_t *)b, (int32_t *)out, vector_length);
+    detail::core(core_id).counters.completed++;
+    return true;
+  });
+}
+
+BEETHOVEN_EMULATED_COUNTERS("myVectorAdd", detail::core)
+
+} // namespace myVectorAdd
+
+///////////////////////////////// vector dot //////////////////////////////////
+
+namespace myVectorDot {
+namespace detail {
+
+struct state {
+  beethoven::emulation::perf_counters counters;
+};
+
+inline state &core(int core_id) {
+  return beethoven::emulation::core_state<state, VECTOR_DOT_N_CORES>(core_id);
+}
+
+} // namespace detail
+
+struct reduce_result {
+  uint64_t value;
+};
+
+inline beethoven::response_handle<reduce_result> reduce(int16_t core_id, uint8_t op,
+                                                        const beethoven::remote_ptr &vec_a_addr,
+                                                        const beethoven::remote_ptr &vec_b_addr,
+                                                        uint32_t vector_length) {
+  uint64_t a = vec_a_addr.getFpgaAddr(), b = vec_b_addr.getFpgaAddr();
+  return beethoven::emulation::submit<reduce_result>("myVectorDot", core_id, [=] {
+    int64_t value = golden::reduce(op, (const int32_t *)a, (const int32_t *)b, vector_length);
+    detail::core(core_id).counters.completed++;
+    return reduce_result{(uint64_t)value};
+  });
+}
+
+BEETHOVEN_EMULATED_COUNTERS("myVectorDot", detail::core)
+
+} // namespace myVectorDot
+
+///////////////////////////////////// FIR /////////////////////////////////////
+
+namespace FIR {
+namespace detail {
+
+struct state {
+  uint32_t taps[ACCEL_WINDOW_SIZE] = {};
+  // the last ACCEL_WINDOW_SIZE - 1 inputs, most recent first
+  uint32_t history[ACCEL_WINDOW_SIZE] = {};
+  beethoven::emulation::perf_counters counters;
+};
+
+inline state &core(int core_id) {
+  return beethoven::emulation::core_state<state, FIR_N_CORES>(core_id);
+}
+
+// products and sum wrap to 32 bits like the output channel
+inline void filter(state &s, uint64_t input_addr, uint64_t output_addr, uint32_t n_elems) {
+  auto *in = (const uint32_t *)input_addr;
+  auto *out = (uint32_t *)output_addr;
+  for (uint32_t e = 0; e < n_elems; ++e) {
+    uint32_t sum = s.taps[0] * in[e];
+    for (int w = 1; w < ACCEL_WINDOW_SIZE; ++w) {
+      sum += s.taps[w] * s.history[w - 1];
+    }
+    for (int w = ACCEL_WINDOW_SIZE - 2; w > 0; --w) {
+      s.history[w] = s.history[w - 1];
+    }
+    s.history[0] = in[e];
+    out[e] = sum;
+  }
+  s.counters.completed++;
+}
+
+} // namespace detail
+
+inline beethoven::response_handle<bool> do_filter(int16_t core_id,
+                                                  const beethoven::remote_ptr &input_addr,
+                                                  uint32_t n_elems,
+                                                  const beethoven::remote_ptr &output_addr) {
+  uint64_t in = input_addr.getFpgaAddr(), out = output_addr.getFpgaAddr();
+  return beethoven::emulation::submit<bool>("FIR", core_id, [=] {
+    auto &s = detail::core(core_id);
+    std::memset(s.history, 0, sizeof(s.history));
+    detail::filter(s, in, out, n_elems);
+    return true;
+  });
+}
+
+inline beethoven::response_handle<bool> continue_filter(int16_t core_id,
+                                                        const beethoven::remote_ptr &input_addr,
+                                                        uint32_t n_elems,
+                                                        const beethoven::remote_ptr &output_addr) {
+  uint64_t in = input_addr.getFpgaAddr(), out = output_addr.getFpgaAddr();
+  return beethoven::emulation::submit<bool>("FIR", core_id, [=] {
+    detail::filter(detail::core(core_id), in, out, n_elems);
+    return true;
+  });
+}
+
+inline beethoven::response_handle<bool> set_taps(int16_t core_id, uint32_t tap_idx,
+                                                 uint32_t tap_value) {
+  return beethoven::emulation::submit<bool>("FIR", core_id, [=] {
+    detail::core(core_id).taps[tap_idx % ACCEL_WINDOW_SIZE] = tap_value;
+    return true;
+  });
+}
+
+inline beethoven::response_handle<bool> load_taps(int16_t core_id,
+                                                  const beethoven::remote_ptr &tap_addr) {
+  uint64_t taps = tap_addr.getFpgaAddr();
+  return beethoven::emulation::submit<bool>("FIR", core_id, [=] {
+    auto &s = detail::core(core_id);
+    std::memcpy(s.taps, (const void *)taps, sizeof(s.taps));
+    s.counters.completed++;
+    return true;
+  });
+}
+
+BEETHOVEN_EMULATED_COUNTERS("FIR", detail::core)
+
+} // namespace FIR
+
+////////////////////////////////// DMAHelper //////////////////////////////////
+
+// word-at-a-time host <-> device access used on AWS F2 (see common/dma.h)
+namespace DMAHelper {
+
+struct memcmd_response {
+  uint32_t payload;
+};
+
+inline beethoven::response_handle<memcmd_response> memcmd(int16_t core_id,
+                                                          const beethoven::remote_ptr &addr,
+                                                          uint32_t payload, uint8_t write) {
+  auto *word = (uint32_t *)addr.getFpgaAddr();
+  return beethoven::emulation::submit<memcmd_response>("DMAHelper", core_id, [=] {
+    if (write) {
+      *word = payload;
+      return memcmd_response{0};
+    }
+    return memcmd_response{*word};
+  });
+}
+
+} // namespace DMAHelper
+
+#undef BEETHOVEN_EMULATED_COUNTERS
+
+#endif
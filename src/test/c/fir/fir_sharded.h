@@ -0,0 +1,88 @@
+#ifndef FIR_SHARDED_H
+#define FIR_SHARDED_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "../common/dma.h"
+
+// Multi-core FIR over one long signal.
+//
+// The signal is cut into one contiguous shard per core. Each shard (except
+// the first) is prefixed with a halo of the ACCEL_WINDOW_SIZE-1 samples that
+// precede it, so when do_filter starts from a zeroed window the halo fills
+// it with exactly the history the one-core run would have had. The halo
+// outputs are dropped when stitching, which makes the result identical to a
+// single do_filter over the whole signal.
+
+namespace fir {
+using namespace beethoven;
+
+constexpr int halo = ACCEL_WINDOW_SIZE - 1;
+
+// load the same taps into every core
+inline void broadcast_taps(const std::vector<int> &taps, int n_cores = FIR_N_CORES) {
+    if ((int)taps.size() != ACCEL_WINDOW_SIZE) {
+        throw std::runtime_error("FIR tap count must equal ACCEL_WINDOW_SIZE");
+    }
+    for (int core = 0; core < n_cores; ++core) {
+        for (int i = 0; i < ACCEL_WINDOW_SIZE; ++i) {
+            FIR::set_taps(core, i, taps[i]);
+        }
+    }
+}
+
+// filter in[0..n) into out[0..n) using every core concurrently
+inline void sharded_filter(fpga_handle_t &handle, const int *in, int n, int *out,
+                           int n_cores = FIR_N_CORES) {
+    if (n <= 0) {
+        return;
+    }
+    // don't bother splitting below one window per core
+    n_cores = std::max(1, std::min(n_cores, n / ACCEL_WINDOW_SIZE));
+    int shard_len = (n + n_cores - 1) / n_cores;
+
+    struct shard {
+        int start, len, lead;
+        remote_ptr in_buf, out_buf;
+    };
+    std::vector<shard> shards;
+    for (int core = 0; core < n_cores && core * shard_len < n; ++core) {
+        shard s;
+        s.start = core * shard_len;
+        s.len = std::min(shard_len, n - s.start);
+        s.lead = std::min(halo, s.start);
+        int total = s.lead + s.len;
+        s.in_buf = trace::malloc(handle, sizeof(int) * total);
+        s.out_buf = trace::malloc(handle, sizeof(int) * total);
+        std::memcpy(s.in_buf.getHostAddr(), in + s.start - s.lead, sizeof(int) * total);
+        dma::copy_to_fpga(s.in_buf);
+        shards.push_back(s);
+    }
+
+    std::vector<trace::traced<decltype(FIR::do_filter(0, remote_ptr(), 0, remote_ptr()))>> running;
+    for (int core = 0; core < (int)shards.size(); ++core) {
+        auto &s = shards[core];
+        int n_elems = s.lead + s.len;
+        running.push_back(trace::issue("do_filter", core, 2 * sizeof(int) * n_elems, [&] {
+            return FIR::do_filter(core, s.in_buf, n_elems, s.out_buf);
+        }));
+    }
+    for (auto &resp : running) {
+        resp.get();
+    }
+
+    for (auto &s : shards) {
+        dma::copy_from_fpga(s.out_buf);
+        std::memcpy(out + s.start, (int *)s.out_buf.getHostAddr() + s.lead, sizeof(int) * s.len);
+        handle.free(s.in_buf);
+        handle.free(s.out_buf);
+    }
+}
+
+} // namespace fir
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef FIR_STREAM_H
+#define FIR_STREAM_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include "../common/dma.h"
+
+// Chunked filtering of an unbounded stream on one FIR core.
+//
+// The first chunk is issued with do_filter (zero history); every later chunk
+// uses continue_filter, so the core keeps the last ACCEL_WINDOW_SIZE-1 samples
+// across commands and the concatenated output equals filtering the whole
+// signal at once.
+//
+// Input and output are double-buffered: while the core filters chunk N, the
+// host copies chunk N+1 into the other input buffer, and chunk N-1's output
+// is copied back while chunk N+1 runs.
+
+namespace fir {
+using namespace beethoven;
+
+class stream {
+private:
+    using response = trace::traced<decltype(FIR::do_filter(0, remote_ptr(), 0, remote_ptr()))>;
+
+    fpga_handle_t &handle;
+    int core;
+    int chunk_elems;
+    remote_ptr in_buf[2], out_buf[2];
+    bool started = false;
+
+    response issue(int buf, int n) {
+        bool cont = started;
+        started = true;
+        return trace::issue(cont ? "continue_filter" : "do_filter", core, 2 * sizeof(int) * n, [&] {
+            return cont ? FIR::continue_filter(core, in_buf[buf], n, out_buf[buf])
+                        : FIR::do_filter(core, in_buf[buf], n, out_buf[buf]);
+        });
+    }
+
+    void stage_input(int buf, const int *in, int n) {
+        std::memcpy(in_buf[buf].getHostAddr(), in, sizeof(int) * n);
+        dma::copy_to_fpga(in_buf[buf]);
+    }
+
+    void drain_output(int buf, int *out, int n) {
+        dma::copy_from_fpga(out_buf[buf]);
+        std::memcpy(out, out_buf[buf].getHostAddr(), sizeof(int) * n);
+    }
+
+public:
+    stream(fpga_handle_t &handle, int core, int chunk_elems)
+        : handle(handle), core(core), chunk_elems(chunk_elems) {
+        if (chunk_elems <= 0) {
+            throw std::runtime_error("FIR stream chunk size must be positive");
+        }
+        for (int i = 0; i < 2; ++i) {
+            in_buf[i] = trace::malloc(handle, sizeof(int) * chunk_elems);
+            out_buf[i] = trace::malloc(handle, sizeof(int) * chunk_elems);
+        }
+    }
+
+    stream(const stream &) = delete;
+    stream &operator=(const stream &) = delete;
+
+    ~stream() {
+        for (int i = 0; i < 2; ++i) {
+            handle.free(in_buf[i]);
+            handle.free(out_buf[i]);
+        }
+    }
+
+    // start a new stream: the next chunk is filtered with zero history
+    void reset() {
+        started = false;
+    }
+
+    // Filter the next n samples of the stream into out. Any n is accepted;
+    // it is split into chunk_elems-sized commands internally.
+    void push(const int *in, int n, int *out) {
+        int n_chunks = (n + chunk_elems - 1) / chunk_elems;
+        auto chunk_len = [&](int c) { return std::min(chunk_elems, n - c * chunk_elems); };
+        std::optional<response> running;
+        int running_chunk = -1;
+        if (n_chunks > 0) {
+            stage_input(0, in, chunk_len(0));
+        }
+        for (int c = 0; c < n_chunks; ++c) {
+            int buf = c % 2;
+            // only one command at a time per core: wait for chunk c-1, then
+            // immediately start chunk c before copying c-1's output back
+            if (running) {
+                running->get();
+            }
+            running.emplace(issue(buf, chunk_len(c)));
+            if (running_chunk >= 0) {
+                drain_output(running_chunk % 2, out + running_chunk * chunk_elems, chunk_len(running_chunk));
+            }
+            running_chunk = c;
+            if (c + 1 < n_chunks) {
+                stage_input(1 - buf, in + (c + 1) * chunk_elems, chunk_len(c + 1));
+            }
+        }
+        if (running) {
+            running->get();
+            drain_output(running_chunk % 2, out + running_chunk * chunk_elems, chunk_len(running_chunk));
+        }
+    }
+};
+
+} // namespace fir
+
+#endif
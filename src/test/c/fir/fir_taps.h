@@ -0,0 +1,88 @@
+#ifndef FIR_TAPS_H
+#define FIR_TAPS_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "../common/dma.h"
+
+// Preloaded tap banks for the FIR cores.
+//
+// Each bank is one ACCEL_WINDOW_SIZE-word device buffer that is uploaded once.
+// Switching a core to a bank is then a single load_taps command that streams
+// the buffer through the core's tap_stream reader, instead of one set_taps
+// round trip per tap.
+
+namespace fir {
+using namespace beethoven;
+
+class tap_banks {
+private:
+    fpga_handle_t &handle;
+    std::vector<remote_ptr> banks;
+
+public:
+    explicit tap_banks(fpga_handle_t &handle) : handle(handle) {}
+
+    tap_banks(const tap_banks &) = delete;
+    tap_banks &operator=(const tap_banks &) = delete;
+
+    ~tap_banks() {
+        for (auto &bank : banks) {
+            handle.free(bank);
+        }
+    }
+
+    // upload a tap vector and return its bank index
+    int add(const std::vector<int> &taps) {
+        if ((int)taps.size() != ACCEL_WINDOW_SIZE) {
+            throw std::runtime_error("FIR tap count must equal ACCEL_WINDOW_SIZE");
+        }
+        auto bank = handle.malloc(sizeof(int) * ACCEL_WINDOW_SIZE);
+        std::memcpy(bank.getHostAddr(), taps.data(), sizeof(int) * ACCEL_WINDOW_SIZE);
+        dma::copy_to_fpga(bank);
+        banks.push_back(bank);
+        return (int)banks.size() - 1;
+    }
+
+    // overwrite an existing bank in place
+    void update(int bank, const std::vector<int> &taps) {
+        if (bank < 0 || bank >= (int)banks.size() || (int)taps.size() != ACCEL_WINDOW_SIZE) {
+            throw std::runtime_error("Invalid FIR tap bank update");
+        }
+        std::memcpy(banks[bank].getHostAddr(), taps.data(), sizeof(int) * ACCEL_WINDOW_SIZE);
+        dma::copy_to_fpga(banks[bank]);
+    }
+
+    // switch cores [0, n_cores) to a bank, all cores load concurrently
+    void select(int bank, int n_cores = FIR_N_CORES) {
+        if (bank < 0 || bank >= (int)banks.size()) {
+            throw std::runtime_error("Invalid FIR tap bank");
+        }
+        std::vector<trace::traced<decltype(FIR::load_taps(0, remote_ptr()))>> loading;
+        for (int core = 0; core < n_cores; ++core) {
+            loading.push_back(trace::issue("load_taps", core, sizeof(int) * ACCEL_WINDOW_SIZE, [&] {
+                return FIR::load_taps(core, banks[bank]);
+            }));
+        }
+        for (auto &resp : loading) {
+            resp.get();
+        }
+    }
+
+    // switch a single core, e.g. to run different filters on different cores
+    void select_core(int bank, int core) {
+        if (bank < 0 || bank >= (int)banks.size()) {
+            throw std::runtime_error("Invalid FIR tap bank");
+        }
+        trace::issue("load_taps", core, sizeof(int) * ACCEL_WINDOW_SIZE, [&] {
+            return FIR::load_taps(core, banks[bank]);
+        }).get();
+    }
+};
+
+} // namespace fir
+
+#endif
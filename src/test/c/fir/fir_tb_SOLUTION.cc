@@ -1,52 +1,20 @@
 #include <beethoven/fpga_handle.h>
 #include <beethoven_hardware.h>
+#include <filesystem>
+#include <string>
 #include <vector>
-#include <deque>
+#include "../common/dataset.h"
+#include "../common/dma.h"
+#include "fir_stream.h"
+#include "fir_sharded.h"
+#include "fir_taps.h"
+#include "../common/golden.h"
+#include "../common/perf_counters.h"
 
 using namespace beethoven;
 
-void dma_workaround_copy_to_fpga(remote_ptr &q) {
-    printf("Copying to FPGA...\n");
-    int sz = q.getLen() / 4;
-    auto * intar = (int*)q.getHostAddr();
-    for (int i = 0; i < sz; ++i) {
-        printf("\rProgress: %d/%d", i, sz); fflush(stdout);
-        auto ptr = q + i * 4;
-        DMAHelper::memcmd(0, q + i * 4, intar[i], 1).get();
-    }
-    printf("\n");
-}
-void dma_workaround_copy_from_fpga(remote_ptr &q) {
-    printf("Copying from FPGA...\n");
-    int sz = q.getLen() / 4;
-    auto * intar = (int*)q.getHostAddr();
-    for (int i = 0; i < sz; ++i) {
-        printf("\rProgress: %d/%d", i, sz); fflush(stdout);
-        auto ptr = q + i * 4;
-        auto resp = DMAHelper::memcmd(0, q + i * 4, 0, 0).get();
-        intar[i] = resp.payload; 
-    }
-    printf("\n");
-}
-
-std::vector<int> golden_fir(const std::vector<int> &in, const std::vector<int> &taps) {
-    std::vector<int> output;
-    std::deque<int> window;
-    for (const auto &i: in) {
-        int sum = 0;
-        // printf("%d\n", i);
-        window.push_front(i);
-        for (int i = 0; i < taps.size() && i < window.size(); ++i) {
-            sum += taps[i] * window[i];
-        }
-        if (window.size() == taps.size())
-            window.pop_back();
-        output.push_back(sum);
-    }
-    return output;
-}
-
 int main() {
+    trace::init_from_env();
     fpga_handle_t handle;
     int data_vector_length = 128;
     std::vector<int> taps;
@@ -65,12 +33,12 @@ int main() {
         fpga_in_host[i] = data;
         input.push_back(data);
     }
-    dma_workaround_copy_to_fpga(fpga_in);
+    dma::copy_to_fpga(fpga_in);
 
     auto fpga_out = handle.malloc(sizeof(int) * data_vector_length);
     FIR::do_filter(0, fpga_in, data_vector_length, fpga_out).get();
-    auto golden_out = golden_fir(input, taps);
-    dma_workaround_copy_from_fpga(fpga_out);
+    auto golden_out = golden::fir(input, taps);
+    dma::copy_from_fpga(fpga_out);
     auto fpga_out_host = (int*)fpga_out.getHostAddr();
     bool success = true;
     for (int i = 0; i < data_vector_length; ++i) {
@@ -79,7 +47,74 @@ int main() {
             success = false;
         }
     }
+
+    // stream the same signal through in uneven chunks, the window history has
+    // to carry across commands for the output to match the one-shot golden
+    fir::stream stream(handle, 0, 48);
+    std::vector<int> streamed(data_vector_length);
+    int split = 100;
+    stream.push(input.data(), split, streamed.data());
+    stream.push(input.data() + split, data_vector_length - split, streamed.data() + split);
+    for (int i = 0; i < data_vector_length; ++i) {
+        if (golden_out[i] != streamed[i]) {
+            printf("stream [%d]: %d =/= %d\n", i, golden_out[i], streamed[i]);
+            success = false;
+        }
+    }
+
+    // a longer signal split across every FIR core with halo overlap
+    int sharded_length = 1000;
+    std::vector<int> long_input(sharded_length), sharded(sharded_length);
+    for (int i = 0; i < sharded_length; ++i) {
+        long_input[i] = (i * 7919) % 1024 - 512;
+    }
+    // swap every core to a second filter with a single load_taps command each
+    std::vector<int> alt_taps;
+    for (int i = 0; i < ACCEL_WINDOW_SIZE; ++i) {
+        alt_taps.push_back(3 - 2 * i);
+    }
+    fir::tap_banks banks(handle);
+    banks.add(taps);
+    int alt_bank = banks.add(alt_taps);
+    banks.select(alt_bank);
+    for (int core = 0; core < FIR_N_CORES; ++core) {
+        FIR::reset_counters(core).get();
+    }
+    fir::sharded_filter(handle, long_input.data(), sharded_length, sharded.data());
+    for (int core = 0; core < FIR_N_CORES; ++core) {
+        auto label = "fir core " + std::to_string(core);
+        perf::read({"input_stream", "tap_stream"}, [core](int id) {
+            return FIR::read_counters(core, id).get().value;
+        }).print(stdout, label.c_str());
+    }
+    auto sharded_golden = golden::fir(long_input, alt_taps);
+    for (int i = 0; i < sharded_length; ++i) {
+        if (sharded_golden[i] != sharded[i]) {
+            printf("sharded [%d]: %d =/= %d\n", i, sharded_golden[i], sharded[i]);
+            success = false;
+        }
+    }
+
+    // the same signal as a capture file, mapped and streamed without a
+    // temporary copy
+    auto capture = (std::filesystem::temp_directory_path() / "fir_capture.bten").string();
+    dataset::write(capture, dataset::describe<int>({(uint64_t)sharded_length}), long_input.data());
+    {
+        dataset::file signal(capture);
+        std::vector<int> from_file(sharded_length);
+        fir::stream file_stream(handle, 0, 256);
+        file_stream.push(signal.as<int>(), (int)signal.info().elements(), from_file.data());
+        for (int i = 0; i < sharded_length; ++i) {
+            if (sharded_golden[i] != from_file[i]) {
+                printf("dataset [%d]: %d =/= %d\n", i, sharded_golden[i], from_file[i]);
+                success = false;
+            }
+        }
+    }
+    std::filesystem::remove(capture);
+
     if (success) {
         printf("Success!\n");
     }
+    return success ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#ifndef SYSTOLIC_CONV2D_H
+#define SYSTOLIC_CONV2D_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "convert.h"
+#include "fixed_point.h"
+#include "gemm.h"
+#include "../common/trace.h"
+
+// 2D convolution on the systolic array, as a GEMM over the im2col matrix.
+//
+//   input   batch x in_height x in_width x channels          (NHWC)
+//   weights kernel_height x kernel_width x channels x out_channels (HWIO)
+//   output  batch x out_height x out_width x out_channels    (NHWC)
+//
+// Row (n, oy, ox) of the im2col matrix holds the taps under output pixel
+// (oy, ox) of image n in (ky, kx, c) order, with zeros for taps in the
+// padding. The HWIO weights are already that GEMM's K x out_channels
+// operand, so output = im2col(input) * weights.
+//
+// When the hardware exports SYSTOLIC_ARRAY_CONV_CHANNELS, the conv command
+// streams each tile's activations straight from the NHWC input, so only the
+// input itself crosses to the device and the im2col matrix (kernel_height *
+// kernel_width times larger) never exists. A tile is DIM consecutive output
+// pixels of one image by DIM output channels. Shapes the command can't take
+// (channels not a multiple of DIM or above the exported limit, an inner
+// dimension over max_inner_dimension) fall back to materializing im2col on
+// the host and running gemm(). Both paths accumulate in the same k order,
+// so the results are bit-identical.
+
+namespace systolic {
+
+struct conv_shape {
+  int batch, in_height, in_width, channels;
+  int out_channels, kernel_height, kernel_width;
+  int stride_h = 1, stride_w = 1;
+  int pad_h = 0, pad_w = 0;
+  int dilation_h = 1, dilation_w = 1;
+
+  int out_height() const {
+    return (in_height + 2 * pad_h - dilation_h * (kernel_height - 1) - 1) / stride_h + 1;
+  }
+  int out_width() const {
+    return (in_width + 2 * pad_w - dilation_w * (kernel_width - 1) - 1) / stride_w + 1;
+  }
+  // GEMM view: M output pixels, K taps per pixel, N output channels
+  int out_pixels() const { return out_height() * out_width(); }
+  int inner_dimension() const { return kernel_height * kernel_width * channels; }
+};
+
+inline void check_conv_shape(const conv_shape &s) {
+  if (s.batch <= 0 || s.in_height <= 0 || s.in_width <= 0 || s.channels <= 0 ||
+      s.out_channels <= 0 || s.kernel_height <= 0 || s.kernel_width <= 0) {
+    throw std::runtime_error("conv2d dimensions must be positive");
+  }
+  if (s.stride_h <= 0 || s.stride_w <= 0 || s.dilation_h <= 0 || s.dilation_w <= 0 ||
+      s.pad_h < 0 || s.pad_w < 0) {
+    throw std::runtime_error("conv2d strides and dilations must be positive, padding non-negative");
+  }
+  if (s.in_height + 2 * s.pad_h < s.dilation_h * (s.kernel_height - 1) + 1 ||
+      s.in_width + 2 * s.pad_w < s.dilation_w * (s.kernel_width - 1) + 1) {
+    throw std::runtime_error("conv2d kernel is larger than the padded input");
+  }
+}
+
+// the materialized im2col matrix, out_pixels() rows per image
+template <typename T>
+inline void im2col(const T *input, const conv_shape &s, T *cols) {
+  int oh = s.out_height(), ow = s.out_width(), C = s.channels;
+  size_t K = s.inner_dimension();
+  for (int n = 0; n < s.batch; ++n) {
+    const T *image = input + (size_t)n * s.in_height * s.in_width * C;
+    for (int oy = 0; oy < oh; ++oy) {
+      for (int ox = 0; ox < ow; ++ox) {
+        T *row = cols + ((size_t)(n * oh + oy) * ow + ox) * K;
+        for (int ky = 0; ky < s.kernel_height; ++ky) {
+          int iy = oy * s.stride_h - s.pad_h + ky * s.dilation_h;
+          for (int kx = 0; kx < s.kernel_width; ++kx) {
+            int ix = ox * s.stride_w - s.pad_w + kx * s.dilation_w;
+            T *taps = row + (size_t)(ky * s.kernel_width + kx) * C;
+            if (iy < 0 || iy >= s.in_height || ix < 0 || ix >= s.in_width) {
+              std::fill(taps, taps + C, T(0));
+            } else {
+              std::copy_n(image + ((size_t)iy * s.in_width + ix) * C, C, taps);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// whether conv2d can stream this shape through the conv command
+inline bool conv_in_hardware(const conv_shape &s) {
+#ifdef SYSTOLIC_ARRAY_CONV_CHANNELS
+  // command field widths: 16-bit sizes and positions, 8-bit kernel geometry
+  bool fits = s.in_height < (1 << 16) && s.in_width < (1 << 16) && s.out_width() < (1 << 16) &&
+              s.out_height() < (1 << 16) && s.kernel_height < 256 && s.kernel_width < 256 &&
+              s.stride_h < 256 && s.stride_w < 256 && s.pad_h < 256 && s.pad_w < 256 &&
+              s.dilation_h < 256 && s.dilation_w < 256;
+  return fits && s.channels % dim == 0 && s.channels <= SYSTOLIC_ARRAY_CONV_CHANNELS &&
+         s.inner_dimension() <= max_inner_dimension;
+#else
+  (void)s;
+  return false;
+#endif
+}
+
+#ifdef SYSTOLIC_ARRAY_CONV_CHANNELS
+// Issue every conv tile against the device-resident input and weight panels.
+// Tile t is (image, pixel tile, channel tile) in row-major order and goes to
+// core t % n_cores; out_tiles holds the tiles in that order.
+inline void conv2d_tiles(uint64_t input, uint64_t wgt_panels, uint64_t out_tiles,
+                         const conv_shape &s, int n_cores = SYSTOLIC_ARRAY_N_CORES,
+                         int max_in_flight = 64) {
+  if (n_cores <= 0 || max_in_flight <= 0) {
+    throw std::runtime_error("conv2d needs at least one core and one command in flight");
+  }
+  int ow = s.out_width(), pixels = s.out_pixels();
+  int pt = n_tiles(pixels), nt = n_tiles(s.out_channels);
+  int K = s.inner_dimension();
+  size_t image_bytes = sizeof(element_t) * s.in_height * s.in_width * s.channels;
+  size_t panel_bytes = sizeof(element_t) * dim * K;
+  size_t tile_bytes = sizeof(element_t) * dim * dim;
+  size_t beat_bytes = sizeof(element_t) * dim;
+
+  auto issue = [&](int t) {
+    int n = t / (pt * nt), pi = t / nt % pt, tj = t % nt;
+    int p0 = pi * dim, core = t % n_cores;
+    return trace::issue("conv", core, beat_bytes * K + tile_bytes, [&] {
+      return SystolicArrayCore::conv(
+          core, s.channels, s.dilation_h, s.dilation_w, s.in_height, s.in_width,
+          input + n * image_bytes, s.kernel_height, s.kernel_width,
+          std::min(dim, pixels - p0), out_tiles + t * tile_bytes, p0 % ow, p0 / ow, ow,
+          s.pad_h, s.pad_w, s.stride_h, s.stride_w, wgt_panels + tj * panel_bytes);
+    });
+  };
+  std::deque<decltype(issue(0))> in_flight;
+  for (int t = 0; t < s.batch * pt * nt; ++t) {
+    if ((int)in_flight.size() == max_in_flight) {
+      in_flight.front().get();
+      in_flight.pop_front();
+    }
+    in_flight.push_back(issue(t));
+  }
+  for (auto &cmd : in_flight) {
+    cmd.get();
+  }
+}
+#endif
+
+// output = conv2d(input, weights), T is element_t or float like gemm()
+template <typename T>
+inline void conv2d(fpga_handle_t &handle, const T *input, const T *weights, T *output,
+                   const conv_shape &s, int n_cores = SYSTOLIC_ARRAY_N_CORES) {
+  static_assert(std::is_same_v<T, element_t> || std::is_same_v<T, float>,
+                "conv2d takes element_t or float tensors");
+  check_conv_shape(s);
+  int M = s.out_pixels(), K = s.inner_dimension(), N = s.out_channels;
+  if (!conv_in_hardware(s)) {
+    std::vector<T> cols((size_t)s.batch * M * K);
+    im2col(input, s, cols.data());
+    gemm(handle, cols.data(), weights, output, s.batch * M, K, N, n_cores);
+    return;
+  }
+#ifdef SYSTOLIC_ARRAY_CONV_CHANNELS
+  size_t input_elems = (size_t)s.batch * s.in_height * s.in_width * s.channels;
+  size_t image_tiles = (size_t)n_tiles(M) * n_tiles(N);
+  auto in = trace::malloc(handle, sizeof(element_t) * input_elems);
+  auto wgt = trace::malloc(handle, wgt_panels_bytes(K, N));
+  auto out = trace::malloc(handle, sizeof(element_t) * s.batch * image_tiles * dim * dim);
+
+  if constexpr (std::is_same_v<T, float>) {
+    to_fixed(input, (element_t *)in.getHostAddr(), input_elems);
+  } else {
+    std::memcpy(in.getHostAddr(), input, sizeof(element_t) * input_elems);
+  }
+  pack_weights(weights, K, N, (element_t *)wgt.getHostAddr());
+  trace::copy_to_fpga(handle, in);
+  trace::copy_to_fpga(handle, wgt);
+
+  conv2d_tiles(in.getFpgaAddr(), wgt.getFpgaAddr(), out.getFpgaAddr(), s, n_cores);
+
+  trace::copy_from_fpga(handle, out);
+  // each image's tiles are a gemm output of M x N
+  for (int n = 0; n < s.batch; ++n) {
+    unpack_output((element_t *)out.getHostAddr() + n * image_tiles * dim * dim, M, N,
+                  output + (size_t)n * M * N);
+  }
+
+  handle.free(in);
+  handle.free(wgt);
+  handle.free(out);
+#endif
+}
+
+} // namespace systolic
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef SYSTOLIC_CONVERT_H
+#define SYSTOLIC_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+#include "fixed_point.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Bulk float <-> fixed-point conversion in the hardware's element format,
+// and the element transpose the packers build the streaming layout with.
+//
+// to_fixed / to_float give the same bits as hw_format::from_double /
+// to_double applied one element at a time (truncation toward zero,
+// saturation to the largest magnitude), without a branch per element. With
+// AVX2 the 8-bit and 16-bit formats convert 16 elements per step; the 32-bit
+// format, whose magnitudes don't fit a float mantissa, and the tails always
+// take the scalar path. NaN converts to the largest magnitude.
+//
+// transpose() moves 8 x 8 blocks through registers (8-bit and 16-bit
+// formats with AVX2), which is one panel's worth of beats for DIM = 8.
+
+namespace systolic {
+
+#if defined(__AVX2__)
+namespace detail {
+
+// 16 floats -> 16 sign-magnitude elements, one per 16-bit lane
+inline __m256i to_fixed_x16(const float *src) {
+  const __m256 scale = _mm256_set1_ps(float(uint64_t(1) << hw_format::frac_bits));
+  const __m256 max_mag = _mm256_set1_ps(float(hw_format::magnitude_mask));
+  const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  __m256i mag[2], neg[2];
+  for (int h = 0; h < 2; ++h) {
+    __m256 x = _mm256_loadu_ps(src + 8 * h);
+    // min() picks max_mag for NaN, like the scalar saturation
+    __m256 scaled = _mm256_min_ps(_mm256_mul_ps(_mm256_and_ps(x, abs_mask), scale), max_mag);
+    mag[h] = _mm256_cvttps_epi32(scaled);
+    neg[h] = _mm256_castps_si256(_mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_LT_OQ));
+  }
+  // packs works per 128-bit lane, the permute puts the halves back in order
+  __m256i m = _mm256_permute4x64_epi64(_mm256_packs_epi32(mag[0], mag[1]), 0xD8);
+  __m256i s = _mm256_permute4x64_epi64(_mm256_packs_epi32(neg[0], neg[1]), 0xD8);
+  return _mm256_or_si256(m, _mm256_and_si256(s, _mm256_set1_epi16((short)hw_format::sign_bit)));
+}
+
+// 8 elements, zero-extended to 32-bit lanes -> 8 floats
+inline __m256 to_float_x8(__m256i raw) {
+  const __m256 inv_scale = _mm256_set1_ps(1.0f / float(uint64_t(1) << hw_format::frac_bits));
+  __m256i mag = _mm256_and_si256(raw, _mm256_set1_epi32(hw_format::magnitude_mask));
+  __m256i sign = _mm256_slli_epi32(_mm256_and_si256(raw, _mm256_set1_epi32(hw_format::sign_bit)),
+                                   32 - hw_format::bits);
+  __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(mag), inv_scale);
+  return _mm256_or_ps(f, _mm256_castsi256_ps(sign));
+}
+
+// dst[c * dst_stride + r] = src[r * src_stride + c] for an 8 x 8 block
+inline void transpose_8x8(const element_t *src, size_t src_stride, element_t *dst,
+                          size_t dst_stride) {
+  __m128i r[8];
+  if constexpr (sizeof(element_t) == 2) {
+    for (int i = 0; i < 8; ++i) {
+      r[i] = _mm_loadu_si128((const __m128i *)(src + i * src_stride));
+    }
+    // interleave pairs of rows, then pairs of pairs, then halves
+    __m128i t[8], u[8];
+    for (int i = 0; i < 4; ++i) {
+      t[2 * i] = _mm_unpacklo_epi16(r[2 * i], r[2 * i + 1]);
+      t[2 * i + 1] = _mm_unpackhi_epi16(r[2 * i], r[2 * i + 1]);
+    }
+    for (int h = 0; h < 2; ++h) {
+      for (int i = 0; i < 2; ++i) {
+        u[4 * h + 2 * i] = _mm_unpacklo_epi32(t[4 * h + i], t[4 * h + i + 2]);
+        u[4 * h + 2 * i + 1] = _mm_unpackhi_epi32(t[4 * h + i], t[4 * h + i + 2]);
+      }
+    }
+    for (int c = 0; c < 4; ++c) {
+      _mm_storeu_si128((__m128i *)(dst + (2 * c) * dst_stride), _mm_unpacklo_epi64(u[c], u[c + 4]));
+      _mm_storeu_si128((__m128i *)(dst + (2 * c + 1) * dst_stride),
+                       _mm_unpackhi_epi64(u[c], u[c + 4]));
+    }
+  } else if constexpr (sizeof(element_t) == 1) {
+    for (int i = 0; i < 8; ++i) {
+      r[i] = _mm_loadl_epi64((const __m128i *)(src + i * src_stride));
+    }
+    __m128i t[4], u[4];
+    for (int i = 0; i < 4; ++i) {
+      t[i] = _mm_unpacklo_epi8(r[2 * i], r[2 * i + 1]);
+    }
+    for (int h = 0; h < 2; ++h) {
+      u[2 * h] = _mm_unpacklo_epi16(t[2 * h], t[2 * h + 1]);
+      u[2 * h + 1] = _mm_unpackhi_epi16(t[2 * h], t[2 * h + 1]);
+    }
+    for (int i = 0; i < 2; ++i) {
+      // two output columns per register
+      __m128i lo = _mm_unpacklo_epi32(u[i], u[i + 2]), hi = _mm_unpackhi_epi32(u[i], u[i + 2]);
+      _mm_storel_epi64((__m128i *)(dst + (4 * i) * dst_stride), lo);
+      _mm_storel_epi64((__m128i *)(dst + (4 * i + 1) * dst_stride), _mm_srli_si128(lo, 8));
+      _mm_storel_epi64((__m128i *)(dst + (4 * i + 2) * dst_stride), hi);
+      _mm_storel_epi64((__m128i *)(dst + (4 * i + 3) * dst_stride), _mm_srli_si128(hi, 8));
+    }
+  }
+}
+
+} // namespace detail
+#endif
+
+// dst[c * dst_stride + r] = src[r * src_stride + c] for a rows x cols block
+inline void transpose(const element_t *src, size_t src_stride, element_t *dst, size_t dst_stride,
+                      int rows, int cols) {
+  int r0 = 0;
+#if defined(__AVX2__)
+  if constexpr (sizeof(element_t) <= 2) {
+    for (; r0 + 8 <= rows; r0 += 8) {
+      int c0 = 0;
+      for (; c0 + 8 <= cols; c0 += 8) {
+        detail::transpose_8x8(src + r0 * src_stride + c0, src_stride, dst + c0 * dst_stride + r0,
+                              dst_stride);
+      }
+      for (int c = c0; c < cols; ++c) {
+        for (int r = r0; r < r0 + 8; ++r) {
+          dst[c * dst_stride + r] = src[r * src_stride + c];
+        }
+      }
+    }
+  }
+#endif
+  for (int c = 0; c < cols; ++c) {
+    for (int r = r0; r < rows; ++r) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+}
+
+inline void to_fixed(const float *src, element_t *dst, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  if constexpr (sizeof(element_t) == 2) {
+    for (; i + 16 <= n; i += 16) {
+      _mm256_storeu_si256((__m256i *)(dst + i), detail::to_fixed_x16(src + i));
+    }
+  } else if constexpr (sizeof(element_t) == 1) {
+    for (; i + 32 <= n; i += 32) {
+      // every 16-bit lane holds an 8-bit pattern, so the unsigned pack is exact
+      __m256i lo = detail::to_fixed_x16(src + i), hi = detail::to_fixed_x16(src + i + 16);
+      __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+      _mm256_storeu_si256((__m256i *)(dst + i), bytes);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = hw_format::from_double(src[i]);
+  }
+}
+
+inline void to_float(const element_t *src, float *dst, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  if constexpr (sizeof(element_t) == 2) {
+    for (; i + 8 <= n; i += 8) {
+      __m256i raw = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+      _mm256_storeu_ps(dst + i, detail::to_float_x8(raw));
+    }
+  } else if constexpr (sizeof(element_t) == 1) {
+    for (; i + 8 <= n; i += 8) {
+      __m256i raw = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+      _mm256_storeu_ps(dst + i, detail::to_float_x8(raw));
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = (float)hw_format::to_double(src[i]);
+  }
+}
+
+} // namespace systolic
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SYSTOLIC_FIXED_POINT_H
+#define SYSTOLIC_FIXED_POINT_H
+
+#include <beethoven_hardware.h>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+// Element format of the systolic array: sign-magnitude fixed point with one
+// sign bit, int_bits integer bits and frac_bits fraction bits, stored in the
+// signed integer type of the same width (int8_t / int16_t / int32_t).
+//
+// hw_format follows whatever the generated beethoven_hardware.h says the
+// hardware was built with, so host code written against element_t works for
+// the 8-bit and 16-bit builds alike.
+
+namespace systolic {
+
+template <int bytes>
+struct storage_of {};
+template <>
+struct storage_of<1> { using type = int8_t; };
+template <>
+struct storage_of<2> { using type = int16_t; };
+template <>
+struct storage_of<4> { using type = int32_t; };
+
+template <int data_width_bytes, int frac_bits_, int int_bits_>
+struct fixed_format {
+  using element = typename storage_of<data_width_bytes>::type;
+  using bits_t = std::make_unsigned_t<element>;
+  static constexpr int bits = 8 * data_width_bytes;
+  static constexpr int frac_bits = frac_bits_;
+  static constexpr int int_bits = int_bits_;
+  static_assert(1 + int_bits + frac_bits == bits, "sign + integer + fraction bits must fill an element");
+
+  static constexpr bits_t sign_bit = bits_t(1) << (bits - 1);
+  static constexpr bits_t magnitude_mask = bits_t(sign_bit - 1);
+
+  static double to_double(element x) {
+    auto raw = (bits_t)x;
+    double f = double(raw & magnitude_mask) / double(uint64_t(1) << frac_bits);
+    return (raw & sign_bit) ? -f : f;
+  }
+
+  // truncates toward zero, magnitudes past the largest representable value
+  // saturate
+  static element from_double(double x) {
+    double scaled = std::fabs(x) * double(uint64_t(1) << frac_bits);
+    bits_t f = scaled >= double(magnitude_mask) ? magnitude_mask : (bits_t)scaled;
+    return (element)(bits_t)(x < 0 ? (f | sign_bit) : f);
+  }
+};
+
+using hw_format = fixed_format<DATA_WIDTH_BYTES, FRAC_BITS, INT_BITS>;
+// one operand / result element as the hardware was built
+using element_t = hw_format::element;
+
+} // namespace systolic
+
+#endif
@@ -0,0 +1,333 @@
+#ifndef SYSTOLIC_GEMM_H
+#define SYSTOLIC_GEMM_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "convert.h"
+#include "fixed_point.h"
+#include "../common/trace.h"
+
+// Host-side tiled GEMM on top of SystolicArrayCore::matmul.
+//
+// C (M x N) = A (M x K) * B (K x N), all row-major sign-magnitude fixed-point
+// elements in the hardware's format (element_t, see fixed_point.h).
+// The product is split into SYSTOLIC_ARRAY_DIM x SYSTOLIC_ARRAY_DIM output
+// tiles. Each tile is one matmul command, and the commands are spread
+// round-robin over the cores without waiting on each response.
+//
+// matmul streams both operands as K beats of DIM elements:
+//   act[k * DIM + i] = A[i][k]   (A tile, column-major)
+//   wgt[k * DIM + j] = B[k][j]   (B tile, row-major)
+// and writes the output tile transposed:
+//   out[j * DIM + i] = C[i][j]
+// Every row-block of A and column-block of B is packed once into a K x DIM
+// "panel", so a tile command only has to point at the right two panels.
+//
+// Long inner dimensions are split into chunks of at most k_chunk beats. The
+// chunks of a tile run as matmul_partial commands that accumulate in the PE
+// array, and one flush writes the finished tile, so a tile is written back
+// once however many chunks it takes. The accumulation order is the same as
+// a single matmul, so the result is bit-identical.
+
+namespace systolic {
+using namespace beethoven;
+
+constexpr int dim = SYSTOLIC_ARRAY_DIM;
+
+// the inner dimension field of the matmul command is 20 bits wide
+constexpr int max_inner_dimension = (1 << 20) - 1;
+
+inline int n_tiles(int n) { return (n + dim - 1) / dim; }
+
+inline void check_gemm_shape(int M, int K, int N) {
+  if (M <= 0 || N <= 0) {
+    throw std::runtime_error("GEMM output dimensions must be positive");
+  }
+  if (K <= 0) {
+    throw std::runtime_error("GEMM inner dimension must be positive");
+  }
+}
+
+// bytes taken by the packed panels / output tiles for a given problem size
+inline size_t act_panels_bytes(int M, int K) {
+  return sizeof(element_t) * n_tiles(M) * K * dim;
+}
+inline size_t wgt_panels_bytes(int K, int N) {
+  return sizeof(element_t) * n_tiles(N) * K * dim;
+}
+inline size_t out_tiles_bytes(int M, int N) {
+  return sizeof(element_t) * n_tiles(M) * n_tiles(N) * dim * dim;
+}
+
+// pack row-major A (M x K) into n_tiles(M) column-major k_depth x DIM
+// panels (k_depth >= K, default K), rows past M and beats past K are zero
+inline void pack_activations(const element_t *A, int M, int K, element_t *dst,
+                             int k_depth = 0) {
+  k_depth = std::max(k_depth, K);
+  for (int ti = 0; ti < n_tiles(M); ++ti) {
+    element_t *panel = dst + (size_t)ti * k_depth * dim;
+    for (int i = 0; i < dim; ++i) {
+      int row = ti * dim + i;
+      for (int k = 0; k < k_depth; ++k) {
+        panel[k * dim + i] = row < M && k < K ? A[(size_t)row * K + k] : 0;
+      }
+    }
+  }
+}
+
+// pack row-major B (K x N) into n_tiles(N) row-major k_depth x DIM panels
+// (k_depth >= K, default K), columns past N and rows past K are zero
+inline void pack_weights(const element_t *B, int K, int N, element_t *dst,
+                         int k_depth = 0) {
+  k_depth = std::max(k_depth, K);
+  for (int tj = 0; tj < n_tiles(N); ++tj) {
+    element_t *panel = dst + (size_t)tj * k_depth * dim;
+    for (int k = 0; k < k_depth; ++k) {
+      for (int j = 0; j < dim; ++j) {
+        int col = tj * dim + j;
+        panel[k * dim + j] = col < N && k < K ? B[(size_t)k * N + col] : 0;
+      }
+    }
+  }
+}
+
+// Float versions of the packers: the conversion to element_t is fused into
+// the packing pass, so the source is read once and no element_t copy of it
+// is made. Activations go through a block of DIM rows x pack_block beats
+// that is converted row by row and then transposed into the panel, so both
+// stay in L1.
+constexpr int pack_block = 256;
+
+// same layout as pack_activations above, from row-major float A (M x K)
+inline void pack_activations(const float *A, int M, int K, element_t *dst, int k_depth = 0) {
+  k_depth = std::max(k_depth, K);
+  std::vector<element_t> block((size_t)dim * pack_block);
+  for (int ti = 0; ti < n_tiles(M); ++ti) {
+    element_t *panel = dst + (size_t)ti * k_depth * dim;
+    for (int k0 = 0; k0 < k_depth; k0 += pack_block) {
+      int width = std::min(pack_block, k_depth - k0);
+      int len = std::max(0, std::min(width, K - k0));
+      for (int i = 0; i < dim; ++i) {
+        int row = ti * dim + i;
+        element_t *b = block.data() + (size_t)i * pack_block;
+        int converted = row < M ? len : 0;
+        if (converted) {
+          to_fixed(A + (size_t)row * K + k0, b, converted);
+        }
+        std::fill(b + converted, b + width, element_t(0));
+      }
+      transpose(block.data(), pack_block, panel + (size_t)k0 * dim, dim, dim, width);
+    }
+  }
+}
+
+// same layout as pack_weights above, from row-major float B (K x N); each
+// source row is converted once and then split over the panels
+inline void pack_weights(const float *B, int K, int N, element_t *dst, int k_depth = 0) {
+  k_depth = std::max(k_depth, K);
+  int nt = n_tiles(N);
+  std::vector<element_t> row((size_t)nt * dim, element_t(0));
+  for (int k = 0; k < k_depth; ++k) {
+    if (k < K) {
+      to_fixed(B + (size_t)k * N, row.data(), N);
+    } else if (k == K) {
+      std::fill(row.begin(), row.end(), element_t(0));
+    }
+    for (int tj = 0; tj < nt; ++tj) {
+      std::copy_n(row.data() + (size_t)tj * dim, dim, dst + ((size_t)tj * k_depth + k) * dim);
+    }
+  }
+}
+
+// scatter the transposed output tiles back into row-major C (M x N)
+inline void unpack_output(const element_t *src, int M, int N, element_t *C) {
+  int nt = n_tiles(N);
+  for (int ti = 0; ti < n_tiles(M); ++ti) {
+    for (int tj = 0; tj < nt; ++tj) {
+      const element_t *tile = src + ((size_t)ti * nt + tj) * dim * dim;
+      for (int j = 0; j < dim && tj * dim + j < N; ++j) {
+        for (int i = 0; i < dim && ti * dim + i < M; ++i) {
+          C[(size_t)(ti * dim + i) * N + tj * dim + j] = tile[j * dim + i];
+        }
+      }
+    }
+  }
+}
+
+// float version of unpack_output: each tile is transposed back to row-major
+// and then converted a row at a time straight into C
+inline void unpack_output(const element_t *src, int M, int N, float *C) {
+  int nt = n_tiles(N);
+  std::vector<element_t> tile((size_t)dim * dim);
+  for (int ti = 0; ti < n_tiles(M); ++ti) {
+    for (int tj = 0; tj < nt; ++tj) {
+      transpose(src + ((size_t)ti * nt + tj) * dim * dim, dim, tile.data(), dim, dim, dim);
+      int width = std::min(dim, N - tj * dim);
+      for (int i = 0; i < dim && ti * dim + i < M; ++i) {
+        to_float(tile.data() + (size_t)i * dim, C + (size_t)(ti * dim + i) * N + tj * dim, width);
+      }
+    }
+  }
+}
+
+// Responses for one output tile: either a single matmul, or a chain of
+// matmul_partial commands closed by a flush.
+struct tile_commands {
+  using matmul_response = trace::traced<decltype(SystolicArrayCore::matmul(0, 0, 0, 0, 0))>;
+  using partial_response =
+      trace::traced<decltype(SystolicArrayCore::matmul_partial(0, false, 0, 0, 0))>;
+  using flush_response = trace::traced<decltype(SystolicArrayCore::flush(0, 0))>;
+
+  std::optional<matmul_response> whole;
+  std::vector<partial_response> partials;
+  std::optional<flush_response> flushed;
+
+  int n_commands() const {
+    return (whole ? 1 : 0) + (int)partials.size() + (flushed ? 1 : 0);
+  }
+
+  void get() {
+    if (whole) whole->get();
+    for (auto &p : partials) p.get();
+    if (flushed) flushed->get();
+  }
+};
+
+// Issue the command(s) for one output tile on one core: a single matmul if K
+// fits in one chunk, otherwise a matmul_partial chain closed by a flush. A
+// core runs its commands in order, so the chain is never interleaved with
+// another tile.
+inline tile_commands issue_tile(int core, uint64_t act, uint64_t wgt, uint64_t out, int K,
+                                int k_chunk = max_inner_dimension) {
+  size_t beat_bytes = sizeof(element_t) * dim;
+  size_t tile_bytes = sizeof(element_t) * dim * dim;
+  tile_commands cmds;
+  if (K <= k_chunk) {
+    cmds.whole.emplace(trace::issue("matmul", core, 2 * beat_bytes * K + tile_bytes, [&] {
+      return SystolicArrayCore::matmul(core, act, K, out, wgt);
+    }));
+    return cmds;
+  }
+  for (int k0 = 0; k0 < K; k0 += k_chunk) {
+    int len = std::min(k_chunk, K - k0);
+    cmds.partials.push_back(trace::issue("matmul_partial", core, 2 * beat_bytes * len, [&] {
+      return SystolicArrayCore::matmul_partial(core, k0 != 0, act + k0 * beat_bytes, len,
+                                               wgt + k0 * beat_bytes);
+    }));
+  }
+  cmds.flushed.emplace(trace::issue("flush", core, tile_bytes, [&] {
+    return SystolicArrayCore::flush(core, out);
+  }));
+  return cmds;
+}
+
+// Bounds the number of outstanding commands: before a tile is issued, the
+// oldest tiles are retired until it fits under max_in_flight.
+class tile_window {
+private:
+  std::deque<tile_commands> in_flight;
+  int outstanding = 0;
+  int max_in_flight;
+
+public:
+  explicit tile_window(int max_in_flight) : max_in_flight(max_in_flight) {
+    if (max_in_flight <= 0) {
+      throw std::runtime_error("GEMM needs at least one command in flight");
+    }
+  }
+
+  void make_room(int n_commands) {
+    while (!in_flight.empty() && outstanding + n_commands > max_in_flight) {
+      in_flight.front().get();
+      outstanding -= in_flight.front().n_commands();
+      in_flight.pop_front();
+    }
+  }
+
+  void push(tile_commands cmds) {
+    outstanding += cmds.n_commands();
+    in_flight.push_back(std::move(cmds));
+  }
+
+  void drain() {
+    for (auto &cmds : in_flight) {
+      cmds.get();
+    }
+    in_flight.clear();
+    outstanding = 0;
+  }
+};
+
+inline int commands_per_tile(int K, int k_chunk) {
+  return K <= k_chunk ? 1 : (K + k_chunk - 1) / k_chunk + 1;
+}
+
+// Issue the commands for every output tile against already-packed device
+// panels. Tile t goes to core (t % n_cores). At most max_in_flight commands
+// are outstanding at once; beyond that the oldest tile is retired first.
+inline void gemm_tiles(uint64_t act_panels, uint64_t wgt_panels,
+                       uint64_t out_tiles, int M, int K, int N,
+                       int n_cores = SYSTOLIC_ARRAY_N_CORES,
+                       int max_in_flight = 64,
+                       int k_chunk = max_inner_dimension) {
+  check_gemm_shape(M, K, N);
+  if (n_cores <= 0) {
+    throw std::runtime_error("GEMM needs at least one core");
+  }
+  if (k_chunk <= 0 || k_chunk > max_inner_dimension) {
+    throw std::runtime_error("GEMM inner dimension chunk out of range");
+  }
+  int mt = n_tiles(M), nt = n_tiles(N);
+  size_t panel_bytes = sizeof(element_t) * dim * K;
+  size_t tile_bytes = sizeof(element_t) * dim * dim;
+  tile_window window(max_in_flight);
+  for (int t = 0; t < mt * nt; ++t) {
+    int ti = t / nt, tj = t % nt;
+    window.make_room(commands_per_tile(K, k_chunk));
+    window.push(issue_tile(t % n_cores, act_panels + ti * panel_bytes,
+                           wgt_panels + tj * panel_bytes, out_tiles + t * tile_bytes, K,
+                           k_chunk));
+  }
+  window.drain();
+}
+
+// C = A * B for arbitrary M, K, N. Allocates scratch device memory for the
+// packed operands and output tiles, and releases it before returning. T is
+// element_t, or float to convert on the way in and out (see to_fixed).
+template <typename T>
+inline void gemm(fpga_handle_t &handle, const T *A, const T *B, T *C, int M, int K, int N,
+                 int n_cores = SYSTOLIC_ARRAY_N_CORES,
+                 int k_chunk = max_inner_dimension) {
+  static_assert(std::is_same_v<T, element_t> || std::is_same_v<T, float>,
+                "gemm takes element_t or float matrices");
+  check_gemm_shape(M, K, N);
+  auto act = trace::malloc(handle, act_panels_bytes(M, K));
+  auto wgt = trace::malloc(handle, wgt_panels_bytes(K, N));
+  auto out = trace::malloc(handle, out_tiles_bytes(M, N));
+
+  pack_activations(A, M, K, (element_t *)act.getHostAddr());
+  pack_weights(B, K, N, (element_t *)wgt.getHostAddr());
+  trace::copy_to_fpga(handle, act);
+  trace::copy_to_fpga(handle, wgt);
+
+  gemm_tiles(act.getFpgaAddr(), wgt.getFpgaAddr(), out.getFpgaAddr(), M, K, N,
+             n_cores, 64, k_chunk);
+
+  trace::copy_from_fpga(handle, out);
+  unpack_output((element_t *)out.getHostAddr(), M, N, C);
+
+  handle.free(act);
+  handle.free(wgt);
+  handle.free(out);
+}
+
+} // namespace systolic
+
+#endif
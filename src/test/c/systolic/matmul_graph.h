@@ -0,0 +1,233 @@
+#ifndef SYSTOLIC_MATMUL_GRAPH_H
+#define SYSTOLIC_MATMUL_GRAPH_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "gemm.h"
+#include "../common/weight_cache.h"
+
+// Chains of dependent matmuls on device-resident buffers.
+//
+// matmul writes each output tile transposed, out[j * DIM + i] = C[i][j],
+// which is the column-major layout matmul reads its activations in. With
+// the output tiles of one row-block stored back to back (as gemm_tiles does),
+// the output buffer of C is already the packed activation panels for C * D,
+// so the next product can read it in place.
+//
+// To make that hold for every tensor, panels are laid out n_tiles(K) * DIM
+// beats apart, the stride of an output row-block. Only the first K beats of
+// a panel are ever streamed: a zero beat is not a no-op for the PEs (an
+// accumulator with the top magnitude bit set flips sign), so the padding
+// must never reach them.
+//   - input(): activations (rows x cols), panels padded to n_tiles(cols) * DIM
+//   - weights(): (rows x cols), panels padded to n_tiles(rows) * DIM
+//   - matmul(a, b): a is an input or another matmul's output, b is weights
+//
+//   systolic::graph g(handle);
+//   auto x = g.input(X, batch, 784);
+//   auto h = g.matmul(x, g.weights(W1, 784, 256));
+//   auto y = g.matmul(h, g.weights(W2, 256, 10));
+//   g.run();
+//   g.read(y, Y);
+//
+// run() issues nodes one dependency level at a time. All tiles of all nodes
+// in a level are spread round-robin over the cores, so independent branches
+// run concurrently, and the host only waits between levels. Intermediate
+// results never leave the device; read() copies back just the tensor asked
+// for. update() replaces an input or weights tensor in place, so the same
+// graph can be run again on new data.
+//
+// Given a cache::weight_cache, weights() looks the packed panels up by the
+// content of the source matrix instead of uploading them, and keeps them
+// pinned for the graph's lifetime. Graphs built per request then share one
+// resident copy of each weight matrix.
+
+namespace systolic {
+using namespace beethoven;
+
+class graph {
+public:
+  using tensor = int;
+
+private:
+  enum kind { k_input, k_weights, k_matmul };
+
+  struct node {
+    kind type;
+    int rows, cols;
+    remote_ptr buf;
+    tensor a = -1, b = -1;
+    int level = 0;
+    std::string cache_key;  // set when buf is owned by the weight cache
+
+    node(kind type, int rows, int cols) : type(type), rows(rows), cols(cols) {}
+  };
+
+  fpga_handle_t &handle;
+  int n_cores;
+  int max_in_flight;
+  cache::weight_cache *weights_cache;
+  std::vector<node> nodes;
+
+  static int padded(int n) { return n_tiles(n) * dim; }
+
+  node &at(tensor t) {
+    if (t < 0 || t >= (int)nodes.size()) {
+      throw std::runtime_error("Invalid matmul graph tensor");
+    }
+    return nodes[t];
+  }
+
+  void upload(node &n, const element_t *data) {
+    if (n.type == k_weights && weights_cache) {
+      size_t src_bytes = sizeof(element_t) * n.rows * n.cols;
+      auto key = cache::content_key(data, src_bytes, ((uint64_t)n.rows << 32) | n.cols);
+      size_t panel_bytes = wgt_panels_bytes(padded(n.rows), n.cols);
+      auto buf = weights_cache->acquire(key, panel_bytes, [&](void *dst) {
+        pack_weights(data, n.rows, n.cols, (element_t *)dst, padded(n.rows));
+      });
+      if (!n.cache_key.empty()) {
+        weights_cache->release(n.cache_key);
+      }
+      n.buf = buf;
+      n.cache_key = key;
+      return;
+    }
+    if (n.type == k_input) {
+      pack_activations(data, n.rows, n.cols, (element_t *)n.buf.getHostAddr(), padded(n.cols));
+    } else {
+      pack_weights(data, n.rows, n.cols, (element_t *)n.buf.getHostAddr(), padded(n.rows));
+    }
+    trace::copy_to_fpga(handle, n.buf);
+  }
+
+  tensor add_leaf(kind type, const element_t *data, int rows, int cols) {
+    if (rows <= 0 || cols <= 0) {
+      throw std::runtime_error("Matmul graph tensor dimensions must be positive");
+    }
+    node n{type, rows, cols};
+    if (type == k_input || !weights_cache) {
+      n.buf = trace::malloc(handle, type == k_input ? act_panels_bytes(rows, padded(cols))
+                                                    : wgt_panels_bytes(padded(rows), cols));
+    }
+    upload(n, data);
+    nodes.push_back(n);
+    return (tensor)nodes.size() - 1;
+  }
+
+public:
+  explicit graph(fpga_handle_t &handle, int n_cores = SYSTOLIC_ARRAY_N_CORES,
+                 int max_in_flight = 64, cache::weight_cache *weights_cache = nullptr)
+      : handle(handle), n_cores(n_cores), max_in_flight(max_in_flight),
+        weights_cache(weights_cache) {
+    if (n_cores <= 0) {
+      throw std::runtime_error("Matmul graph needs at least one core");
+    }
+  }
+
+  graph(const graph &) = delete;
+  graph &operator=(const graph &) = delete;
+
+  ~graph() {
+    for (auto &n : nodes) {
+      if (n.cache_key.empty()) {
+        handle.free(n.buf);
+      } else {
+        weights_cache->release(n.cache_key);
+      }
+    }
+  }
+
+  // row-major activations (rows x cols), uploaded once
+  tensor input(const element_t *A, int rows, int cols) {
+    return add_leaf(k_input, A, rows, cols);
+  }
+
+  // row-major weights (rows x cols), uploaded once
+  tensor weights(const element_t *B, int rows, int cols) {
+    return add_leaf(k_weights, B, rows, cols);
+  }
+
+  // a * b, with the output kept on the device
+  tensor matmul(tensor a, tensor b) {
+    auto &na = at(a), &nb = at(b);
+    if (na.type == k_weights || nb.type != k_weights) {
+      throw std::runtime_error("Matmul graph multiplies activations by weights");
+    }
+    if (na.cols != nb.rows) {
+      throw std::runtime_error("Matmul graph inner dimensions don't match");
+    }
+    if (na.cols > max_inner_dimension) {
+      throw std::runtime_error("Matmul graph inner dimension out of range");
+    }
+    node n{k_matmul, na.rows, nb.cols};
+    n.a = a;
+    n.b = b;
+    n.level = na.level + 1;
+    n.buf = trace::malloc(handle, out_tiles_bytes(n.rows, n.cols));
+    nodes.push_back(n);
+    return (tensor)nodes.size() - 1;
+  }
+
+  // replace the contents of an input or weights tensor
+  void update(tensor t, const element_t *data) {
+    auto &n = at(t);
+    if (n.type == k_matmul) {
+      throw std::runtime_error("Only graph inputs and weights can be updated");
+    }
+    upload(n, data);
+  }
+
+  // run every matmul node, level by level
+  void run() {
+    int depth = 0;
+    for (auto &n : nodes) {
+      depth = std::max(depth, n.level);
+    }
+    size_t tile_bytes = sizeof(element_t) * dim * dim;
+    tile_window window(max_in_flight);
+    int next_core = 0;
+    for (int level = 1; level <= depth; ++level) {
+      for (auto &n : nodes) {
+        if (n.type != k_matmul || n.level != level) {
+          continue;
+        }
+        int K = nodes[n.a].cols;
+        size_t panel_bytes = sizeof(element_t) * dim * padded(K);
+        uint64_t act = nodes[n.a].buf.getFpgaAddr(), wgt = nodes[n.b].buf.getFpgaAddr();
+        int mt = n_tiles(n.rows), nt = n_tiles(n.cols);
+        for (int t = 0; t < mt * nt; ++t) {
+          int ti = t / nt, tj = t % nt;
+          window.make_room(1);
+          window.push(issue_tile(next_core, act + ti * panel_bytes, wgt + tj * panel_bytes,
+                                 n.buf.getFpgaAddr() + t * tile_bytes, K));
+          next_core = (next_core + 1) % n_cores;
+        }
+      }
+      // the next level reads these outputs
+      window.drain();
+    }
+  }
+
+  // copy a tensor back as row-major (rows x cols)
+  void read(tensor t, element_t *C) {
+    auto &n = at(t);
+    if (n.type != k_matmul) {
+      throw std::runtime_error("Only matmul outputs can be read back from a graph");
+    }
+    trace::copy_from_fpga(handle, n.buf);
+    unpack_output((element_t *)n.buf.getHostAddr(), n.rows, n.cols, C);
+  }
+
+  int rows(tensor t) { return at(t).rows; }
+  int cols(tensor t) { return at(t).cols; }
+};
+
+} // namespace systolic
+
+#endif
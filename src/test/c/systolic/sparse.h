@@ -0,0 +1,182 @@
+#ifndef SYSTOLIC_SPARSE_H
+#define SYSTOLIC_SPARSE_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+#include "fixed_point.h"
+#include "gemm.h"
+#include "../common/trace.h"
+
+// Block-sparse GEMM: C (M x N) = A (M x K) * B (K x N) with pruned weights.
+//
+// B is cut into the same column panels as gemm(), and each panel into K
+// slices of DIM weights (one weight beat). Slices whose weights are all zero
+// (either sign) are dropped, CSR-style:
+//   occupancy  per panel, occupancy_words(K) 32-bit words; bit k % 32 of
+//              word k / 32 is set when slice k is stored
+//   row_ptr    per panel, the index of its first stored slice; the last
+//              entry is the total
+//   slices     the stored slices, panel by panel in k order
+//
+// When the hardware exports SYSTOLIC_ARRAY_SPARSE, each tile is one
+// matmul_sparse command. It reads only the stored weight slices and the
+// activation beats that meet them, and the array runs only those beats, so
+// time and traffic scale with the occupancy. Tiles against an empty panel
+// aren't issued at all, because their output is zero. The result is
+// bit-identical to gemm() over the dense B. Without the export the panels are
+// decoded and gemm() runs dense.
+
+namespace systolic {
+
+inline int occupancy_words(int K) { return (K + 31) / 32; }
+
+struct sparse_weights {
+  int K = 0, N = 0;
+  std::vector<uint32_t> occupancy;
+  std::vector<uint32_t> row_ptr;
+  std::vector<element_t> slices;
+
+  int n_panels() const { return n_tiles(N); }
+  int n_slices(int panel) const { return row_ptr[panel + 1] - row_ptr[panel]; }
+  bool occupied(int panel, int k) const {
+    return (occupancy[(size_t)panel * occupancy_words(K) + k / 32] >> (k % 32)) & 1;
+  }
+  // share of the K x n_panels slices that are stored
+  double density() const { return double(row_ptr.back()) / ((double)K * n_panels()); }
+};
+
+// encode row-major B (K x N); columns past N pad the last panel with zeros
+inline sparse_weights encode_sparse(const element_t *B, int K, int N) {
+  check_gemm_shape(1, K, N);
+  if (K > max_inner_dimension) {
+    throw std::runtime_error("sparse GEMM inner dimension exceeds the matmul command's");
+  }
+  sparse_weights w;
+  w.K = K;
+  w.N = N;
+  int nt = n_tiles(N), words = occupancy_words(K);
+  w.occupancy.assign((size_t)nt * words, 0);
+  w.row_ptr.push_back(0);
+  element_t slice[dim];
+  for (int tj = 0; tj < nt; ++tj) {
+    for (int k = 0; k < K; ++k) {
+      bool empty = true;
+      for (int j = 0; j < dim; ++j) {
+        int col = tj * dim + j;
+        slice[j] = col < N ? B[(size_t)k * N + col] : 0;
+        empty &= (slice[j] & hw_format::magnitude_mask) == 0;
+      }
+      if (!empty) {
+        w.occupancy[(size_t)tj * words + k / 32] |= uint32_t(1) << (k % 32);
+        w.slices.insert(w.slices.end(), slice, slice + dim);
+      }
+    }
+    w.row_ptr.push_back((uint32_t)(w.slices.size() / dim));
+  }
+  return w;
+}
+
+// back to row-major K x N, empty slices as +0
+inline void decode_sparse(const sparse_weights &w, element_t *B) {
+  std::fill(B, B + (size_t)w.K * w.N, element_t(0));
+  for (int tj = 0; tj < w.n_panels(); ++tj) {
+    const element_t *slice = w.slices.data() + (size_t)w.row_ptr[tj] * dim;
+    for (int k = 0; k < w.K; ++k) {
+      if (!w.occupied(tj, k)) continue;
+      for (int j = 0; j < dim && tj * dim + j < w.N; ++j) {
+        B[(size_t)k * w.N + tj * dim + j] = slice[j];
+      }
+      slice += dim;
+    }
+  }
+}
+
+#ifdef SYSTOLIC_ARRAY_SPARSE
+// Issue a matmul_sparse for every tile with a non-empty weight panel, tile t
+// on core t % n_cores; the output tiles of empty panels are left untouched.
+inline void gemm_sparse_tiles(uint64_t act_panels, uint64_t slices, uint64_t occupancy,
+                              uint64_t out_tiles, int M, const sparse_weights &w,
+                              int n_cores = SYSTOLIC_ARRAY_N_CORES, int max_in_flight = 64) {
+  if (n_cores <= 0 || max_in_flight <= 0) {
+    throw std::runtime_error("sparse GEMM needs at least one core and one command in flight");
+  }
+  int K = w.K, mt = n_tiles(M), nt = w.n_panels();
+  size_t beat_bytes = sizeof(element_t) * dim;
+  size_t tile_bytes = beat_bytes * dim;
+  size_t occupancy_bytes = sizeof(uint32_t) * occupancy_words(K);
+
+  auto issue = [&](int t) {
+    int ti = t / nt, tj = t % nt, core = t % n_cores;
+    int stored = w.n_slices(tj);
+    return trace::issue("matmul_sparse", core, 2 * beat_bytes * stored + tile_bytes, [&] {
+      return SystolicArrayCore::matmul_sparse(
+          core, act_panels + ti * beat_bytes * K, K, stored, occupancy + tj * occupancy_bytes,
+          out_tiles + t * tile_bytes, slices + w.row_ptr[tj] * beat_bytes);
+    });
+  };
+  std::deque<decltype(issue(0))> in_flight;
+  for (int t = 0; t < mt * nt; ++t) {
+    if (w.n_slices(t % nt) == 0) continue;
+    if ((int)in_flight.size() == max_in_flight) {
+      in_flight.front().get();
+      in_flight.pop_front();
+    }
+    in_flight.push_back(issue(t));
+  }
+  for (auto &cmd : in_flight) {
+    cmd.get();
+  }
+}
+#endif
+
+// C = A * decode_sparse(w), A row-major M x w.K
+inline void gemm_sparse(fpga_handle_t &handle, const element_t *A, const sparse_weights &w,
+                        element_t *C, int M, int n_cores = SYSTOLIC_ARRAY_N_CORES) {
+  check_gemm_shape(M, w.K, w.N);
+#ifdef SYSTOLIC_ARRAY_SPARSE
+  int K = w.K, N = w.N;
+  auto act = trace::malloc(handle, act_panels_bytes(M, K));
+  auto slices = trace::malloc(handle, sizeof(element_t) * std::max<size_t>(w.slices.size(), dim));
+  auto occupancy = trace::malloc(handle, sizeof(uint32_t) * w.occupancy.size());
+  auto out = trace::malloc(handle, out_tiles_bytes(M, N));
+
+  pack_activations(A, M, K, (element_t *)act.getHostAddr());
+  std::copy(w.slices.begin(), w.slices.end(), (element_t *)slices.getHostAddr());
+  std::copy(w.occupancy.begin(), w.occupancy.end(), (uint32_t *)occupancy.getHostAddr());
+  trace::copy_to_fpga(handle, act);
+  trace::copy_to_fpga(handle, slices);
+  trace::copy_to_fpga(handle, occupancy);
+
+  gemm_sparse_tiles(act.getFpgaAddr(), slices.getFpgaAddr(), occupancy.getFpgaAddr(),
+                    out.getFpgaAddr(), M, w, n_cores);
+
+  trace::copy_from_fpga(handle, out);
+  auto *tiles = (element_t *)out.getHostAddr();
+  int nt = w.n_panels();
+  for (int t = 0; t < n_tiles(M) * nt; ++t) {
+    if (w.n_slices(t % nt) == 0) {
+      std::fill(tiles + (size_t)t * dim * dim, tiles + (size_t)(t + 1) * dim * dim, element_t(0));
+    }
+  }
+  unpack_output(tiles, M, N, C);
+
+  handle.free(act);
+  handle.free(slices);
+  handle.free(occupancy);
+  handle.free(out);
+#else
+  std::vector<element_t> B((size_t)w.K * w.N);
+  decode_sparse(w, B.data());
+  gemm(handle, A, B.data(), C, M, w.K, w.N, n_cores);
+#endif
+}
+
+} // namespace systolic
+
+#endif
@@ -1,37 +1,371 @@
 #include <beethoven/fpga_handle.h>
 #include <beethoven_hardware.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
 #include <random>
+#include <string>
+#include <vector>
+#include "conv2d.h"
+#include "convert.h"
+#include "gemm.h"
+#include "matmul_graph.h"
+#include "sparse.h"
+#include "../common/dataset.h"
+#include "../common/golden.h"
+#include "../common/perf_counters.h"
 using namespace beethoven;
+using systolic::element_t;
+using systolic::hw_format;
 
 // convert from sign-magnitude fixed-point to floating point
-double fixp_to_fp(int16_t a) {
-  auto f = double(a & 0x7FFF) / (1 << FRAC_BITS);
-  return (a & 0x8000) ? -f : f;
-}
+double fixp_to_fp(element_t a) { return hw_format::to_double(a); }
 
 // inverse of the previous function
-double fp_to_fixp(double a) {
-  int16_t f = abs(a) * (1 << FRAC_BITS);
-  if (a < 0) {
-    f |= 0x8000;
+element_t fp_to_fixp(double a) { return hw_format::from_double(a); }
+
+// arbitrary-size GEMM through the tiling library, checked bit-for-bit against
+// the fixed-point golden model
+bool test_gemm(fpga_handle_t &handle, int M, int K, int N,
+               int k_chunk = systolic::max_inner_dimension) {
+  std::random_device rd;
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::default_random_engine eng(rd());
+
+  std::vector<element_t> A(M * K), B(K * N), C(M * N), gold(M * N);
+  for (auto &a : A) a = fp_to_fixp(dist(eng));
+  for (auto &b : B) b = fp_to_fixp(dist(eng));
+
+  systolic::gemm(handle, A.data(), B.data(), C.data(), M, K, N,
+                 SYSTOLIC_ARRAY_N_CORES, k_chunk);
+  golden::gemm<FRAC_BITS>(A.data(), B.data(), gold.data(), M, K, N);
+
+  int errors = 0;
+  for (int i = 0; i < M; ++i) {
+    for (int j = 0; j < N; ++j) {
+      if (gold[i * N + j] != C[i * N + j] && errors++ < 10) {
+        printf("GEMM [%d][%d]: %0.4f =/= %0.4f\n", i, j, fixp_to_fp(C[i * N + j]),
+               fixp_to_fp(gold[i * N + j]));
+      }
+    }
+  }
+  printf("GEMM %dx%dx%d (K chunk %d): %s\n", M, K, N, std::min(K, k_chunk),
+         errors ? "FAILED" : "PASSED");
+  return errors == 0;
+}
+
+// conv2d checked against a golden GEMM over the host-built im2col matrix;
+// float tensors must give the same bits as converting them up front
+bool test_conv2d(fpga_handle_t &handle, const systolic::conv_shape &s) {
+  std::random_device rd;
+  std::uniform_real_distribution<float> dist(-1, 1);
+  std::default_random_engine eng(rd());
+  int M = s.batch * s.out_pixels(), K = s.inner_dimension(), N = s.out_channels;
+
+  std::vector<float> in_f((size_t)s.batch * s.in_height * s.in_width * s.channels);
+  std::vector<float> wgt_f((size_t)K * N), out_f((size_t)M * N);
+  for (auto &x : in_f) x = dist(eng);
+  for (auto &w : wgt_f) w = dist(eng);
+  std::vector<element_t> in(in_f.size()), wgt(wgt_f.size()), out(out_f.size());
+  systolic::to_fixed(in_f.data(), in.data(), in.size());
+  systolic::to_fixed(wgt_f.data(), wgt.data(), wgt.size());
+
+  systolic::conv2d(handle, in.data(), wgt.data(), out.data(), s);
+  systolic::conv2d(handle, in_f.data(), wgt_f.data(), out_f.data(), s);
+  std::vector<element_t> cols((size_t)M * K), gold((size_t)M * N);
+  systolic::im2col(in.data(), s, cols.data());
+  golden::gemm<FRAC_BITS>(cols.data(), wgt.data(), gold.data(), M, K, N);
+
+  int errors = 0;
+  for (size_t i = 0; i < gold.size(); ++i) {
+    float want = (float)fixp_to_fp(gold[i]);
+    if ((out[i] != gold[i] || out_f[i] != want) && errors++ < 10) {
+      printf("conv2d [%zu]: %0.4f / %0.4f =/= %0.4f\n", i, fixp_to_fp(out[i]), out_f[i], want);
+    }
+  }
+  printf("conv2d %dx%dx%dx%d -> %d, %dx%d kernel, stride %d/%d, pad %d/%d, dilation %d/%d (%s): %s\n",
+         s.batch, s.in_height, s.in_width, s.channels, s.out_channels, s.kernel_height,
+         s.kernel_width, s.stride_h, s.stride_w, s.pad_h, s.pad_w, s.dilation_h, s.dilation_w,
+         systolic::conv_in_hardware(s) ? "conv command" : "host im2col",
+         errors ? "FAILED" : "PASSED");
+  return errors == 0;
+}
+
+// block-sparse weights (runs of empty slices at the start, middle and end
+// of panels, one panel empty) must give exactly the dense result, including
+// accumulators that overflow across skipped slices
+bool test_sparse_gemm(fpga_handle_t &handle, int M, int K, int N, double density) {
+  std::random_device rd;
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::uniform_real_distribution<double> coin(0, 1);
+  std::default_random_engine eng(rd());
+
+  std::vector<element_t> A(M * K), B(K * N, 0), C(M * N), gold(M * N);
+  for (auto &a : A) a = fp_to_fixp(dist(eng));
+  int block = 4;
+  for (int k0 = 0; k0 < K; k0 += block) {
+    for (int tj = 1; tj < systolic::n_tiles(N); ++tj) {
+      if (coin(eng) >= density) continue;
+      for (int k = k0; k < std::min(K, k0 + block); ++k) {
+        for (int j = tj * SYSTOLIC_ARRAY_DIM; j < std::min(N, (tj + 1) * SYSTOLIC_ARRAY_DIM); ++j) {
+          B[k * N + j] = fp_to_fixp(dist(eng));
+        }
+      }
+    }
+  }
+  // panel 1 stores only slice 1, which leaves its accumulators at exactly the
+  // overflow bit's magnitude, the one value a zero-product MAC changes (it
+  // flips the sign); the odd trailing gap after it has to be replayed
+  element_t root = fp_to_fixp(std::ldexp(1.0, (INT_BITS - 1) / 2));
+  for (int i = 0; i < M; ++i) A[i * K + 1] = root;
+  for (int k = 0; k < K; ++k) {
+    for (int j = SYSTOLIC_ARRAY_DIM; j < std::min(N, 2 * SYSTOLIC_ARRAY_DIM); ++j) {
+      B[k * N + j] = k == 1 ? root : 0;
+    }
+  }
+  auto w = systolic::encode_sparse(B.data(), K, N);
+  std::vector<element_t> decoded(K * N);
+  systolic::decode_sparse(w, decoded.data());
+  systolic::gemm_sparse(handle, A.data(), w, C.data(), M);
+  golden::gemm<FRAC_BITS>(A.data(), B.data(), gold.data(), M, K, N);
+
+  int errors = decoded != B;
+  for (int i = 0; i < M * N; ++i) {
+    if (gold[i] != C[i] && errors++ < 10) {
+      printf("Sparse GEMM [%d][%d]: %0.4f =/= %0.4f\n", i / N, i % N, fixp_to_fp(C[i]),
+             fixp_to_fp(gold[i]));
+    }
+  }
+  printf("Sparse GEMM %dx%dx%d, %.0f%% of slices stored: %s\n", M, K, N, 100 * w.density(),
+         errors ? "FAILED" : "PASSED");
+  return errors == 0;
+}
+
+// bulk conversion and the fused float packers must give exactly the bits of
+// the scalar conversion, including saturation, tails and padding; then a
+// float GEMM through them is checked against the golden model
+bool test_float_gemm(fpga_handle_t &handle) {
+  std::random_device rd;
+  std::uniform_real_distribution<float> wide(-2 * (1 << INT_BITS), 2 * (1 << INT_BITS));
+  std::uniform_real_distribution<float> dist(-1, 1);
+  std::default_random_engine eng(rd());
+  bool ok = true;
+
+  std::vector<float> x(1000);
+  for (auto &v : x) v = wide(eng);
+  x[0] = 0.0f, x[1] = -0.0f, x[2] = 1e-9f, x[3] = -1e-9f, x[4] = 1e30f, x[5] = -1e30f;
+  std::vector<element_t> fixed(x.size());
+  std::vector<float> back(x.size());
+  systolic::to_fixed(x.data(), fixed.data(), x.size());
+  systolic::to_float(fixed.data(), back.data(), x.size());
+  for (size_t i = 0; i < x.size(); ++i) {
+    ok &= fixed[i] == fp_to_fixp(x[i]) && back[i] == (float)fixp_to_fp(fixed[i]);
+  }
+
+  int M = 2 * SYSTOLIC_ARRAY_DIM + 3, K = 2 * systolic::pack_block + 7, N = SYSTOLIC_ARRAY_DIM + 5;
+  std::vector<float> A(M * K), B(K * N), C(M * N);
+  for (auto &a : A) a = dist(eng);
+  for (auto &b : B) b = dist(eng);
+  std::vector<element_t> A_fixed(M * K), B_fixed(K * N), gold(M * N);
+  for (int i = 0; i < M * K; ++i) A_fixed[i] = fp_to_fixp(A[i]);
+  for (int i = 0; i < K * N; ++i) B_fixed[i] = fp_to_fixp(B[i]);
+  int k_depth = K + 5;
+  size_t act_elems = systolic::act_panels_bytes(M, k_depth) / sizeof(element_t);
+  size_t wgt_elems = systolic::wgt_panels_bytes(k_depth, N) / sizeof(element_t);
+  std::vector<element_t> act(act_elems), act_gold(act_elems), wgt(wgt_elems), wgt_gold(wgt_elems);
+  systolic::pack_activations(A.data(), M, K, act.data(), k_depth);
+  systolic::pack_activations(A_fixed.data(), M, K, act_gold.data(), k_depth);
+  systolic::pack_weights(B.data(), K, N, wgt.data(), k_depth);
+  systolic::pack_weights(B_fixed.data(), K, N, wgt_gold.data(), k_depth);
+  ok &= act == act_gold && wgt == wgt_gold;
+
+  systolic::gemm(handle, A.data(), B.data(), C.data(), M, K, N);
+  golden::gemm<FRAC_BITS>(A_fixed.data(), B_fixed.data(), gold.data(), M, K, N);
+  for (int i = 0; i < M * N; ++i) {
+    ok &= C[i] == (float)fixp_to_fp(gold[i]);
+  }
+  printf("Float GEMM %dx%dx%d with bulk conversion: %s\n", M, K, N, ok ? "PASSED" : "FAILED");
+  return ok;
+}
+
+// GEMM operands read straight from memory-mapped dataset files, a chunked
+// load() whose device copy has to match the file, and the header checks
+bool test_dataset(fpga_handle_t &handle) {
+  std::random_device rd;
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::default_random_engine eng(rd());
+  int M = 2 * SYSTOLIC_ARRAY_DIM + 1, K = 45, N = SYSTOLIC_ARRAY_DIM + 3;
+  std::vector<element_t> A(M * K), B(K * N), C(M * N), gold(M * N);
+  for (auto *v : {&A, &B}) {
+    for (auto &x : *v) x = fp_to_fixp(dist(eng));
+  }
+  auto dir = std::filesystem::temp_directory_path();
+  auto a_path = (dir / ("systolic_a_" + std::to_string(rd()) + ".bten")).string();
+  auto b_path = (dir / ("systolic_b_" + std::to_string(rd()) + ".bten")).string();
+  dataset::write(a_path, dataset::describe_fixed<element_t>({(uint64_t)M, (uint64_t)K}, FRAC_BITS,
+                                                            INT_BITS), A.data());
+  dataset::write(b_path, dataset::describe_fixed<element_t>({(uint64_t)K, (uint64_t)N}, FRAC_BITS,
+                                                            INT_BITS), B.data());
+  bool ok = true;
+  {
+    dataset::file a(a_path), b(b_path);
+    ok &= a.info().shape == std::vector<uint64_t>{(uint64_t)M, (uint64_t)K};
+    systolic::gemm(handle, a.as_fixed<element_t>(FRAC_BITS, INT_BITS),
+                   b.as_fixed<element_t>(FRAC_BITS, INT_BITS), C.data(), M, K, N);
+    golden::gemm<FRAC_BITS>(A.data(), B.data(), gold.data(), M, K, N);
+    ok &= C == gold;
+
+    // a chunk size that doesn't divide the data, so the last one is short
+    auto loaded = dataset::load(handle, a, 1000);
+    std::memset(loaded.getHostAddr(), 0, a.bytes());
+    handle.copy_from_fpga(loaded);
+    ok &= std::memcmp(loaded.getHostAddr(), A.data(), a.bytes()) == 0;
+    handle.free(loaded);
+
+    // the overlapped path hands each chunk over once, in order, already filled
+    auto dst = handle.malloc(a.bytes());
+    std::memset(dst.getHostAddr(), 0, a.bytes());
+    size_t covered = 0;
+    dataset::load_into(a, dst, 1000, [&](const remote_ptr &segment) {
+      size_t offset = segment.getFpgaAddr() - dst.getFpgaAddr();
+      ok &= offset == covered && (char *)segment.getHostAddr() == (char *)dst.getHostAddr() + offset &&
+            std::memcmp(segment.getHostAddr(), (char *)A.data() + offset, segment.getLen()) == 0;
+      covered += segment.getLen();
+    });
+    ok &= covered == a.bytes();
+    handle.free(dst);
+
+    auto throws = [](auto &&f) {
+      try {
+        f();
+      } catch (const std::runtime_error &) {
+        return true;
+      }
+      return false;
+    };
+    ok &= throws([&] { a.as<float>(); });
+    ok &= throws([&] { a.as_fixed<element_t>(FRAC_BITS + 1, INT_BITS - 1); });
+    std::filesystem::resize_file(b_path, dataset::header_bytes + b.bytes() - 1);
+    ok &= throws([&] { dataset::file truncated(b_path); });
+  }
+  std::filesystem::remove(a_path);
+  std::filesystem::remove(b_path);
+  printf("GEMM from mapped dataset files %dx%dx%d: %s\n", M, K, N, ok ? "PASSED" : "FAILED");
+  return ok;
+}
+
+// A*B -> C -> C*D kept on the device, plus an independent A*B2 branch in the
+// same level as A*B
+bool test_graph(fpga_handle_t &handle) {
+  std::random_device rd;
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::default_random_engine eng(rd());
+  int M = 13, K = 21, N = 11, P = 7, Q = 9;
+  std::vector<element_t> A(M * K), B(K * N), D(N * P), B2(K * Q);
+  for (auto *v : {&A, &B, &D, &B2}) {
+    for (auto &x : *v) x = fp_to_fixp(dist(eng));
+  }
+
+  systolic::graph g(handle);
+  auto a = g.input(A.data(), M, K);
+  auto c = g.matmul(a, g.weights(B.data(), K, N));
+  auto e = g.matmul(c, g.weights(D.data(), N, P));
+  auto f = g.matmul(a, g.weights(B2.data(), K, Q));
+  g.run();
+  std::vector<element_t> E(M * P), F(M * Q);
+  g.read(e, E.data());
+  g.read(f, F.data());
+
+  std::vector<element_t> gold_c(M * N), gold_e(M * P), gold_f(M * Q);
+  golden::gemm<FRAC_BITS>(A.data(), B.data(), gold_c.data(), M, K, N);
+  golden::gemm<FRAC_BITS>(gold_c.data(), D.data(), gold_e.data(), M, N, P);
+  golden::gemm<FRAC_BITS>(A.data(), B2.data(), gold_f.data(), M, K, Q);
+  bool ok = E == gold_e && F == gold_f;
+  printf("Matmul graph: %s\n", ok ? "PASSED" : "FAILED");
+  return ok;
+}
+
+// chained graph matmuls whose inner dimensions leave an odd number of padding
+// beats in every panel. C[0][0] and E[0][0] end exactly at the overflow bit's
+// magnitude, the one value a zero-product MAC changes (it flips the sign), so
+// streaming the padding would make them differ from the golden model
+bool test_graph_padding(fpga_handle_t &handle) {
+  std::random_device rd;
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::default_random_engine eng(rd());
+  int M = 5, K = 2 * SYSTOLIC_ARRAY_DIM - 1, N = 2 * SYSTOLIC_ARRAY_DIM - 1, P = 3;
+  std::vector<element_t> A(M * K), B(K * N), D(N * P);
+  for (auto *v : {&A, &B, &D}) {
+    for (auto &x : *v) x = fp_to_fixp(dist(eng));
   }
-  return f;
+  element_t root = fp_to_fixp(std::ldexp(1.0, (INT_BITS - 1) / 2));
+  for (int k = 0; k < K; ++k) {
+    A[k] = k == 0 ? root : 0;
+    B[k * N] = k == 0 ? root : 0;
+  }
+  for (int j = 0; j < N; ++j) {
+    D[j * P] = j == 0 ? fp_to_fixp(1.0) : 0;
+  }
+
+  systolic::graph g(handle);
+  auto c = g.matmul(g.input(A.data(), M, K), g.weights(B.data(), K, N));
+  auto e = g.matmul(c, g.weights(D.data(), N, P));
+  g.run();
+  std::vector<element_t> C(M * N), E(M * P);
+  g.read(c, C.data());
+  g.read(e, E.data());
+
+  std::vector<element_t> gold_c(M * N), gold_e(M * P);
+  golden::gemm<FRAC_BITS>(A.data(), B.data(), gold_c.data(), M, K, N);
+  golden::gemm<FRAC_BITS>(gold_c.data(), D.data(), gold_e.data(), M, N, P);
+  bool ok = C == gold_c && E == gold_e;
+  printf("Matmul graph with padded panels (K = %d, N = %d): %s\n", K, N, ok ? "PASSED" : "FAILED");
+  return ok;
+}
+
+// two requests through per-request graphs share the same weights: the second
+// one must hit the cache for every weight matrix instead of uploading again
+bool test_weight_cache(fpga_handle_t &handle) {
+  std::random_device rd;
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::default_random_engine eng(rd());
+  int M = 5, K = 19, N = 10;
+  std::vector<element_t> W(K * N), X(M * K), Y(M * N), gold(M * N);
+  for (auto &w : W) w = fp_to_fixp(dist(eng));
+
+  cache::weight_cache weights_cache(handle, 1 << 20);
+  bool ok = true;
+  for (int request = 0; request < 2; ++request) {
+    for (auto &x : X) x = fp_to_fixp(dist(eng));
+    systolic::graph g(handle, SYSTOLIC_ARRAY_N_CORES, 64, &weights_cache);
+    auto y = g.matmul(g.input(X.data(), M, K), g.weights(W.data(), K, N));
+    g.run();
+    g.read(y, Y.data());
+    golden::gemm<FRAC_BITS>(X.data(), W.data(), gold.data(), M, K, N);
+    ok &= Y == gold;
+  }
+  auto st = weights_cache.get_stats();
+  ok &= st.misses == 1 && st.hits == 1;
+  printf("Weight cache: %zu hits, %zu misses, %zu bytes uploaded: %s\n", st.hits, st.misses,
+         st.bytes_uploaded, ok ? "PASSED" : "FAILED");
+  return ok;
 }
 
 int main() {
+  trace::init_from_env();
   fpga_handle_t handle;
   int inner_dimension = 1;
 
-  // this testbench relies on uint16_t...
-  assert(DATA_WIDTH_BYTES == 2);
-
-  // allocate memory for the accelerator
+  // allocate memory for the accelerator, element_t is sized to match
+  // DATA_WIDTH_BYTES
   auto activations =
-      handle.malloc(sizeof(int16_t) * SYSTOLIC_ARRAY_DIM * inner_dimension);
+      handle.malloc(sizeof(element_t) * SYSTOLIC_ARRAY_DIM * inner_dimension);
   auto weights =
-      handle.malloc(sizeof(int16_t) * SYSTOLIC_ARRAY_DIM * inner_dimension);
+      handle.malloc(sizeof(element_t) * SYSTOLIC_ARRAY_DIM * inner_dimension);
   auto outputs =
-      handle.malloc(sizeof(int16_t) * SYSTOLIC_ARRAY_DIM * SYSTOLIC_ARRAY_DIM);
+      handle.malloc(sizeof(element_t) * SYSTOLIC_ARRAY_DIM * SYSTOLIC_ARRAY_DIM);
 
   // random number generation
   std::random_device rd;
@@ -39,9 +373,9 @@ int main() {
   std::default_random_engine eng(rd());
 
   // get host pointers out of the memory handles
-  int16_t *host_act = (int16_t *)activations.getHostAddr(),
-          *host_wgt = (int16_t *)weights.getHostAddr(),
-          *host_out = (int16_t *)outputs.getHostAddr();
+  element_t *host_act = (element_t *)activations.getHostAddr(),
+          *host_wgt = (element_t *)weights.getHostAddr(),
+          *host_out = (element_t *)outputs.getHostAddr();
 
   // allocate arrays for golden model
   float *gold_act = new float[inner_dimension * SYSTOLIC_ARRAY_DIM];
@@ -51,7 +385,7 @@ int main() {
   // sanity checks for our fixed-point <-> floating-point conversions
   assert(fixp_to_fp(fp_to_fixp(3)) == 3);
   assert(fixp_to_fp(fp_to_fixp(0.5)) == 0.5);
-  assert(fixp_to_fp(fp_to_fixp(-8)) == -8);
+  assert(fixp_to_fp(fp_to_fixp(-(1 << (INT_BITS - 1)))) == -(1 << (INT_BITS - 1)));
 
   // initialize arrays like usual
   // MINUTIAE: You _might_ notice that host_act is **INCORRECTLY** indexed.
@@ -114,5 +448,34 @@ int main() {
     }
     printf("\n");
   }
+
+  // multi-tile problem with ragged edges in every dimension
+  for (int core = 0; core < SYSTOLIC_ARRAY_N_CORES; ++core) {
+    SystolicArrayCore::reset_counters(core).get();
+  }
+  bool success = test_gemm(handle, 3 * SYSTOLIC_ARRAY_DIM + 5, 37,
+                           2 * SYSTOLIC_ARRAY_DIM + 3);
+  // same shape with K split over matmul_partial commands and a flush per tile
+  success &= test_gemm(handle, 3 * SYSTOLIC_ARRAY_DIM + 5, 37,
+                       2 * SYSTOLIC_ARRAY_DIM + 3, 16);
+  success &= test_float_gemm(handle);
+  success &= test_dataset(handle);
+  success &= test_sparse_gemm(handle, 2 * SYSTOLIC_ARRAY_DIM + 3, 203, 3 * SYSTOLIC_ARRAY_DIM + 5, 0.3);
+  // output rows narrower and wider than a tile, padding on every side, a
+  // strided dilated kernel, and a channel count only the fallback takes
+  success &= test_conv2d(handle, {2, 9, 11, 2 * SYSTOLIC_ARRAY_DIM, 10, 3, 3, 1, 1, 1, 1});
+  success &= test_conv2d(handle, {1, 12, 10, SYSTOLIC_ARRAY_DIM, SYSTOLIC_ARRAY_DIM, 3, 3,
+                                  2, 2, 2, 2, 2, 2});
+  success &= test_conv2d(handle, {1, 7, 7, 3, 5, 2, 3, 1, 1, 1, 0});
+  success &= test_graph(handle);
+  success &= test_graph_padding(handle);
+  success &= test_weight_cache(handle);
+  for (int core = 0; core < SYSTOLIC_ARRAY_N_CORES; ++core) {
+    auto label = "matmul core " + std::to_string(core);
+    perf::read({"weights", "activations"}, [core](int id) {
+      return SystolicArrayCore::read_counters(core, id).get().value;
+    }).print(stdout, label.c_str());
+  }
   handle.shutdown();
+  return success ? 0 : 1;
 }
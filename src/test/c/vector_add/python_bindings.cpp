@@ -1,108 +1,225 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
-#include <beethoven/fpga_handle.h>
-#include <beethoven_hardware.h>
+#include <pybind11/numpy.h>
 #include <unordered_map>
+#include <chrono>
 #include <memory>
+#include <tuple>
+#include "vector_add_session.h"
 
-using namespace beethoven;
+// Python-side handle on an in-flight command. result() blocks with the GIL
+// released, and awaiting it from asyncio parks the wait on an executor thread.
+class CommandFuture {
+private:
+    std::shared_future<bool> fut;
+
+public:
+    explicit CommandFuture(std::shared_future<bool> fut) : fut(std::move(fut)) {}
 
+    bool done() const {
+        return fut.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    // callers must not hold the GIL
+    bool wait() const {
+        return fut.get();
+    }
+
+    bool result() const {
+        pybind11::gil_scoped_release release;
+        return wait();
+    }
+};
+
+// Python face of a VectorAddSession: every method can be called from many
+// threads at once (e.g. a request-serving thread pool), and the GIL is
+// released around everything that blocks or takes a session lock.
 class BeethovenWrapper {
 private:
-    fpga_handle_t handle;
-    std::unordered_map<size_t, decltype(handle.malloc(0))> memory_map;
-    size_t next_id = 0;
-    
+    VectorAddSession session;
+
 public:
-    BeethovenWrapper() = default;
-    
     // Allocate memory and return a handle ID
     size_t malloc(size_t size) {
-        auto mem = handle.malloc(size);
-        memory_map[next_id] = mem;
-        return next_id++;
+        pybind11::gil_scoped_release release;
+        return session.malloc(size);
     }
     
     // Get host pointer for a memory ID (returns memory address as integer)
     uintptr_t get_host_ptr(size_t mem_id) {
-        if (memory_map.find(mem_id) == memory_map.end()) {
-            throw std::runtime_error("Invalid memory ID");
-        }
-        return reinterpret_cast<uintptr_t>(memory_map[mem_id].getHostAddr());
+        return reinterpret_cast<uintptr_t>(session.lookup(mem_id).getHostAddr());
     }
     
     // Write integer array to memory
     void write_int_array(size_t mem_id, const std::vector<int>& data) {
-        if (memory_map.find(mem_id) == memory_map.end()) {
-            throw std::runtime_error("Invalid memory ID");
-        }
-        
-        auto host_ptr = static_cast<int*>(memory_map[mem_id].getHostAddr());
-        std::memcpy(host_ptr, data.data(), data.size() * sizeof(int));
+        session.write_int_array(mem_id, data);
     }
     
     // Read integer array from memory
     std::vector<int> read_int_array(size_t mem_id, size_t num_elements) {
-        if (memory_map.find(mem_id) == memory_map.end()) {
-            throw std::runtime_error("Invalid memory ID");
-        }
-        
-        auto host_ptr = static_cast<int*>(memory_map[mem_id].getHostAddr());
-        std::vector<int> result(num_elements);
-        std::memcpy(result.data(), host_ptr, num_elements * sizeof(int));
-        return result;
+        return session.read_int_array(mem_id, num_elements);
     }
     
+    // Zero-copy NumPy view directly on the allocation's host memory. Writes to
+    // the array land in the segment that copy_to_fpga transfers, and
+    // copy_from_fpga results show up in it without another copy. The view's
+    // base is a capsule holding the segment and `self` (the wrapper), so a
+    // view that outlives free_memory(mem_id) still owns its segment, and the
+    // segment only goes back to the pool once the last view is gone.
+    pybind11::array as_array(size_t mem_id, const pybind11::object &dtype_like,
+                             std::vector<pybind11::ssize_t> shape, pybind11::handle self) {
+        auto entry = session.find(mem_id);
+        size_t mem_size = entry.size;
+        auto dtype = pybind11::dtype::from_args(dtype_like);
+        size_t itemsize = dtype.itemsize();
+        if (shape.empty()) {
+            shape.push_back(mem_size / itemsize);
+        }
+        size_t n_bytes = itemsize;
+        for (auto dim : shape) {
+            if (dim < 0) {
+                throw std::runtime_error("Negative array dimension");
+            }
+            n_bytes *= dim;
+        }
+        if (n_bytes > mem_size) {
+            throw std::runtime_error("Requested view is larger than the allocation");
+        }
+        // block is declared last so it's returned to the pool before the
+        // (possibly last) reference to the wrapper that owns the pool goes;
+        // capsule destructors run with the GIL held, so dropping it is safe
+        struct view_owner {
+            pybind11::object wrapper;
+            std::shared_ptr<PooledBlock> block;
+        };
+        auto *keep = new view_owner{pybind11::reinterpret_borrow<pybind11::object>(self), entry.block};
+        pybind11::capsule owner(keep, [](void *p) { delete static_cast<view_owner *>(p); });
+        return pybind11::array(dtype, shape, entry.block->get().getHostAddr(), owner);
+    }
+
+    // Copy any C-contiguous buffer (NumPy array, bytes, memoryview, ...) into
+    // the allocation as raw bytes, with no per-element conversion
+    void write_buffer(size_t mem_id, const pybind11::buffer &data, size_t byte_offset) {
+        auto entry = session.find(mem_id);
+        auto info = data.request();
+        pybind11::ssize_t expected_stride = info.itemsize;
+        for (int d = info.ndim - 1; d >= 0; --d) {
+            if (info.shape[d] > 1 && info.strides[d] != expected_stride) {
+                throw std::runtime_error("Buffer must be C-contiguous");
+            }
+            expected_stride *= info.shape[d];
+        }
+        size_t n_bytes = info.size * info.itemsize;
+        if (byte_offset + n_bytes > entry.size) {
+            throw std::runtime_error("Write is larger than the allocation");
+        }
+        pybind11::gil_scoped_release release;
+        std::memcpy(static_cast<char*>(entry.block->get().getHostAddr()) + byte_offset, info.ptr, n_bytes);
+    }
+
     // Copy data to FPGA
     void copy_to_fpga(size_t mem_id) {
-        if (memory_map.find(mem_id) == memory_map.end()) {
-            throw std::runtime_error("Invalid memory ID");
-        }
-        handle.copy_to_fpga(memory_map[mem_id]);
+        pybind11::gil_scoped_release release;
+        session.copy_to_fpga(mem_id);
     }
     
     // Copy data from FPGA
     void copy_from_fpga(size_t mem_id) {
-        if (memory_map.find(mem_id) == memory_map.end()) {
-            throw std::runtime_error("Invalid memory ID");
-        }
-        handle.copy_from_fpga(memory_map[mem_id]);
+        pybind11::gil_scoped_release release;
+        session.copy_from_fpga(mem_id);
     }
     
-    // Vector addition
+    // Vector addition on the least loaded core, blocking until it completes
     bool vector_add(size_t vec_a_mem_id, size_t vec_b_mem_id, size_t vec_out_mem_id, int n_eles) {
-        if (memory_map.find(vec_a_mem_id) == memory_map.end() ||
-            memory_map.find(vec_b_mem_id) == memory_map.end() ||
-            memory_map.find(vec_out_mem_id) == memory_map.end()) {
-            throw std::runtime_error("Invalid memory ID");
+        // don't hold the interpreter hostage while the accelerator works
+        pybind11::gil_scoped_release release;
+        return session.submit(vec_a_mem_id, vec_b_mem_id, vec_out_mem_id, n_eles, -1).get();
+    }
+
+    // Queue a vector addition and return immediately. core_id < 0 picks the
+    // core with the fewest commands in flight.
+    CommandFuture vector_add_async(size_t vec_a_mem_id, size_t vec_b_mem_id, size_t vec_out_mem_id,
+                                   int n_eles, int core_id) {
+        pybind11::gil_scoped_release release;
+        return CommandFuture(session.submit(vec_a_mem_id, vec_b_mem_id, vec_out_mem_id, n_eles, core_id));
+    }
+
+    // Queue a list of (vec_a, vec_b, vec_out, n_eles) commands spread over all cores
+    std::vector<CommandFuture> vector_add_batch(
+            const std::vector<std::tuple<size_t, size_t, size_t, int>> &commands) {
+        std::vector<CommandFuture> futures;
+        futures.reserve(commands.size());
+        pybind11::gil_scoped_release release;
+        for (const auto &cmd : commands) {
+            futures.emplace_back(session.submit(std::get<0>(cmd), std::get<1>(cmd), std::get<2>(cmd),
+                                                std::get<3>(cmd), -1));
         }
-        
-        auto resp_handle = myVectorAdd::vector_add(
-            0,
-            memory_map[vec_a_mem_id],
-            memory_map[vec_b_mem_id],
-            memory_map[vec_out_mem_id],
-            n_eles
-        );
-        
-        auto response = resp_handle.get();
-        return response;
+        return futures;
+    }
+
+    // Wait for a set of futures with the GIL released and return all their results
+    static std::vector<bool> wait_all(const std::vector<CommandFuture> &futures) {
+        pybind11::gil_scoped_release release;
+        std::vector<bool> results;
+        results.reserve(futures.size());
+        for (const auto &fut : futures) {
+            results.push_back(fut.wait());
+        }
+        return results;
     }
     
-    // Free memory
+    // Free memory: the ID is gone at once, the segment returns to the pool
+    // when no NumPy view of it is left
     void free_memory(size_t mem_id) {
-        memory_map.erase(mem_id);
+        // the pool's lock is taken if this was the last reference
+        pybind11::gil_scoped_release release;
+        session.free_memory(mem_id);
+    }
+
+    // Pre-allocate `count` segments able to hold `size` bytes
+    void reserve_memory(size_t size, int count) {
+        pybind11::gil_scoped_release release;
+        session.reserve_memory(size, count);
+    }
+
+    // Give every cached (freed) segment back to the device allocator
+    void trim_memory() {
+        session.trim_memory();
+    }
+
+    // Pool statistics, including the high-water mark of device memory use
+    std::unordered_map<std::string, size_t> get_memory_stats() {
+        auto st = session.get_memory_stats();
+        return {
+            {"bytes_in_use", st.bytes_in_use},
+            {"bytes_cached", st.bytes_cached},
+            {"high_water_mark", st.high_water_mark},
+            {"peak_in_use", st.peak_in_use},
+            {"hits", st.hits},
+            {"misses", st.misses},
+        };
     }
     
     // Get number of allocated memories (for debugging)
-    size_t get_memory_count() const {
-        return memory_map.size();
+    size_t get_memory_count() {
+        return session.get_memory_count();
     }
 };
 
 PYBIND11_MODULE(beethoven_python, m) {
-    m.doc() = "Beethoven FPGA Python bindings - integers only";
+    m.doc() = "Beethoven FPGA Python bindings";
     
+    pybind11::class_<CommandFuture>(m, "CommandFuture")
+        .def("done", &CommandFuture::done,
+             "True once the accelerator has responded")
+        .def("result", &CommandFuture::result,
+             "Block (without the GIL) until the command completes and return its status")
+        .def("__await__", [](pybind11::object self) {
+                 auto loop = pybind11::module_::import("asyncio").attr("get_running_loop")();
+                 return loop.attr("run_in_executor")(pybind11::none(), self.attr("result"))
+                     .attr("__await__")();
+             });
+
     pybind11::class_<BeethovenWrapper>(m, "BeethovenWrapper")
         .def(pybind11::init<>())
         .def("malloc", &BeethovenWrapper::malloc, 
@@ -113,14 +230,39 @@ PYBIND11_MODULE(beethoven_python, m) {
              "Write integer array to memory")
         .def("read_int_array", &BeethovenWrapper::read_int_array,
              "Read integer array from memory")
+        .def("as_array",
+             [](pybind11::object self, size_t mem_id, const pybind11::object &dtype,
+                std::vector<pybind11::ssize_t> shape) {
+                 return self.cast<BeethovenWrapper&>().as_array(mem_id, dtype, std::move(shape), self);
+             },
+             pybind11::arg("mem_id"), pybind11::arg("dtype") = "int32",
+             pybind11::arg("shape") = std::vector<pybind11::ssize_t>(),
+             "Zero-copy NumPy view of an allocation's host memory (any dtype)")
+        .def("write_buffer", &BeethovenWrapper::write_buffer,
+             pybind11::arg("mem_id"), pybind11::arg("data"), pybind11::arg("byte_offset") = 0,
+             "Copy a contiguous buffer into memory without element conversion")
         .def("copy_to_fpga", &BeethovenWrapper::copy_to_fpga,
              "Copy data from host to FPGA")
         .def("copy_from_fpga", &BeethovenWrapper::copy_from_fpga,
              "Copy data from FPGA to host")
         .def("vector_add", &BeethovenWrapper::vector_add,
              "Perform vector addition on FPGA")
+        .def("vector_add_async", &BeethovenWrapper::vector_add_async,
+             pybind11::arg("vec_a_mem_id"), pybind11::arg("vec_b_mem_id"),
+             pybind11::arg("vec_out_mem_id"), pybind11::arg("n_eles"), pybind11::arg("core_id") = -1,
+             "Queue a vector addition (least loaded core by default) and return a CommandFuture")
+        .def("vector_add_batch", &BeethovenWrapper::vector_add_batch,
+             "Queue (vec_a, vec_b, vec_out, n_eles) commands across all cores")
+        .def_static("wait_all", &BeethovenWrapper::wait_all,
+                    "Wait for a list of CommandFutures and return their results")
         .def("free_memory", &BeethovenWrapper::free_memory,
              "Free allocated memory")
+        .def("reserve_memory", &BeethovenWrapper::reserve_memory,
+             "Pre-allocate pooled segments of a given size")
+        .def("trim_memory", &BeethovenWrapper::trim_memory,
+             "Release cached segments back to the device allocator")
+        .def("get_memory_stats", &BeethovenWrapper::get_memory_stats,
+             "Get pool allocator statistics")
         .def("get_memory_count", &BeethovenWrapper::get_memory_count,
              "Get number of allocated memories");
 }
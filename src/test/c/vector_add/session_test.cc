@@ -0,0 +1,84 @@
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "vector_add_session.h"
+
+// The state behind the Python wrapper, driven the way the Python tests drive
+// it: many threads allocating, submitting and freeing at once, and a segment
+// that outlives free_memory() because something (a NumPy view) still holds it.
+
+static bool test_concurrent_requests(VectorAddSession &session) {
+    const int n_threads = 8, n_requests = 64;
+    std::atomic<int> failed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int r = t; r < n_requests; r += n_threads) {
+                int n_eles = 1000 + r;
+                auto a_id = session.malloc(4 * n_eles), b_id = session.malloc(4 * n_eles);
+                auto out_id = session.malloc(4 * n_eles);
+                std::vector<int> a(n_eles), b(n_eles, r);
+                for (int i = 0; i < n_eles; ++i) {
+                    a[i] = i + r;
+                }
+                session.write_int_array(a_id, a);
+                session.write_int_array(b_id, b);
+                session.copy_to_fpga(a_id);
+                session.copy_to_fpga(b_id);
+                // alternate between the least loaded core and a fixed one
+                int core = r % 2 ? -1 : r % VECTOR_ADD_N_CORES;
+                bool ok = session.submit(a_id, b_id, out_id, n_eles, core).get();
+                session.copy_from_fpga(out_id);
+                auto out = session.read_int_array(out_id, n_eles);
+                for (int i = 0; i < n_eles; ++i) {
+                    ok &= out[i] == a[i] + b[i];
+                }
+                if (!ok) {
+                    failed++;
+                }
+                session.free_memory(a_id);
+                session.free_memory(b_id);
+                session.free_memory(out_id);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    bool passed = failed == 0 && session.get_memory_count() == 0;
+    printf("%s concurrent requests (%d requests, %d threads, %d wrong)\n",
+           passed ? "PASSED" : "FAILED", n_requests, n_threads, failed.load());
+    return passed;
+}
+
+static bool test_segment_outlives_free(VectorAddSession &session) {
+    const size_t n_bytes = 4096;
+    // start from empty free lists so only the held segment could be reused
+    session.trim_memory();
+    auto mem_id = session.malloc(n_bytes);
+    // what a NumPy view's capsule holds
+    auto view = session.find(mem_id);
+    session.free_memory(mem_id);
+
+    auto hits_before = session.get_memory_stats().hits;
+    auto other_id = session.malloc(n_bytes);
+    bool passed = session.get_memory_stats().hits == hits_before &&
+                  session.lookup(other_id).getHostAddr() != view.block->get().getHostAddr();
+
+    // the last holder letting go returns the segment for the next allocation
+    view = {};
+    auto third_id = session.malloc(n_bytes);
+    passed &= session.get_memory_stats().hits == hits_before + 1;
+    session.free_memory(other_id);
+    session.free_memory(third_id);
+    printf("%s segment held past free_memory\n", passed ? "PASSED" : "FAILED");
+    return passed;
+}
+
+int main() {
+    VectorAddSession session;
+    bool passed = test_concurrent_requests(session);
+    passed &= test_segment_outlives_free(session);
+    return passed ? 0 : 1;
+}
@@ -43,6 +43,16 @@ def test_basic_functionality():
     final_count = fpga.get_memory_count()
     print(f"✔️ Memory freed, final count: {final_count}")
 
+    # the freed segment should be recycled by the pool
+    hits_before = fpga.get_memory_stats()["hits"]
+    mem_id = fpga.malloc(20)
+    stats = fpga.get_memory_stats()
+    if stats["hits"] == hits_before + 1:
+        print(f"✔️ Pool reuse PASSED (high-water mark: {stats['high_water_mark']} bytes)")
+    else:
+        print("❌ Pool reuse FAILED")
+    fpga.free_memory(mem_id)
+
 def test_simple_vector_addition():
     print("\n=== Testing Simple Vector Addition (4 elements) ===")
     
@@ -187,6 +197,163 @@ def test_vector_addition_full():
     except Exception as e:
         print(f"❌ Vector addition test failed with error: {e}")
 
+def test_numpy_zero_copy():
+    print("\n=== Testing Zero-Copy NumPy Vector Addition ===")
+
+    import numpy as np
+    fpga = beethoven_python.BeethovenWrapper()
+    n_eles = 1024
+
+    try:
+        vec_a_id = fpga.malloc(4 * n_eles)
+        vec_b_id = fpga.malloc(4 * n_eles)
+        vec_out_id = fpga.malloc(4 * n_eles)
+
+        # views sit directly on the allocations' host memory
+        vec_a = fpga.as_array(vec_a_id, np.int32)
+        vec_b = fpga.as_array(vec_b_id, np.int32)
+        vec_out = fpga.as_array(vec_out_id, np.int32)
+
+        vec_a[:] = np.arange(n_eles, dtype=np.int32) + 1
+        fpga.write_buffer(vec_b_id, np.arange(n_eles, dtype=np.int32) * 2)
+        expected = vec_a + vec_b
+
+        fpga.copy_to_fpga(vec_a_id)
+        fpga.copy_to_fpga(vec_b_id)
+        if not fpga.vector_add(vec_a_id, vec_b_id, vec_out_id, n_eles):
+            print("❌ Vector addition failed")
+        fpga.copy_from_fpga(vec_out_id)
+
+        if np.array_equal(vec_out, expected):
+            print("✔️ Zero-copy test PASSED")
+        else:
+            print("❌ Zero-copy test FAILED")
+
+        del vec_a, vec_b, vec_out
+        fpga.free_memory(vec_a_id)
+        fpga.free_memory(vec_b_id)
+        fpga.free_memory(vec_out_id)
+
+    except Exception as e:
+        print(f"❌ Zero-copy test failed with error: {e}")
+
+def test_view_outlives_free():
+    print("\n=== Testing a NumPy View That Outlives free_memory ===")
+
+    import numpy as np
+    fpga = beethoven_python.BeethovenWrapper()
+    n_eles = 256
+
+    try:
+        mem_id = fpga.malloc(4 * n_eles)
+        view = fpga.as_array(mem_id, np.int32)
+        view[:] = 7
+        fpga.free_memory(mem_id)
+
+        # the view still owns the segment, so the pool must not hand it out
+        hits_before = fpga.get_memory_stats()["hits"]
+        other_id = fpga.malloc(4 * n_eles)
+        other = fpga.as_array(other_id, np.int32)
+        other[:] = 1
+        view[:] = 9
+        passed = (fpga.get_memory_stats()["hits"] == hits_before and
+                  fpga.get_host_ptr(other_id) != view.ctypes.data and
+                  np.all(other == 1) and np.all(view == 9))
+
+        # dropping the last view returns the segment, and the next
+        # allocation of that size reuses it
+        del view
+        third_id = fpga.malloc(4 * n_eles)
+        passed = passed and fpga.get_memory_stats()["hits"] == hits_before + 1
+
+        print("✔️ View ownership test PASSED" if passed else "❌ View ownership test FAILED")
+        del other
+        fpga.free_memory(other_id)
+        fpga.free_memory(third_id)
+
+    except Exception as e:
+        print(f"❌ View ownership test failed with error: {e}")
+
+def test_async_submission():
+    print("\n=== Testing Async / Batched Vector Addition ===")
+
+    import asyncio
+    import numpy as np
+    fpga = beethoven_python.BeethovenWrapper()
+    n_eles = 256
+    n_cmds = 6
+
+    try:
+        commands = []
+        outputs = []
+        for c in range(n_cmds):
+            a_id, b_id, out_id = (fpga.malloc(4 * n_eles) for _ in range(3))
+            fpga.as_array(a_id)[:] = np.arange(n_eles, dtype=np.int32) + c
+            fpga.as_array(b_id)[:] = np.arange(n_eles, dtype=np.int32) * 2
+            fpga.copy_to_fpga(a_id)
+            fpga.copy_to_fpga(b_id)
+            commands.append((a_id, b_id, out_id, n_eles))
+            outputs.append(out_id)
+
+        # batch submission is spread over every core, least loaded first
+        futures = fpga.vector_add_batch(commands)
+        statuses = beethoven_python.BeethovenWrapper.wait_all(futures)
+
+        # single commands can also be awaited from asyncio
+        async def await_one():
+            return await fpga.vector_add_async(*commands[0])
+        statuses.append(asyncio.run(await_one()))
+
+        passed = all(statuses)
+        for c, out_id in enumerate(outputs):
+            fpga.copy_from_fpga(out_id)
+            expected = np.arange(n_eles, dtype=np.int32) * 3 + c
+            passed = passed and np.array_equal(fpga.as_array(out_id), expected)
+
+        print("✔️ Async test PASSED" if passed else "❌ Async test FAILED")
+
+        for a_id, b_id, out_id, _ in commands:
+            fpga.free_memory(a_id)
+            fpga.free_memory(b_id)
+            fpga.free_memory(out_id)
+
+    except Exception as e:
+        print(f"❌ Async test failed with error: {e}")
+
+def test_concurrent_submission():
+    print("\n=== Testing Concurrent Submission From a Thread Pool ===")
+
+    from concurrent.futures import ThreadPoolExecutor
+    import numpy as np
+    fpga = beethoven_python.BeethovenWrapper()
+    n_eles = 1024
+    n_requests = 64
+
+    # one request: allocate, fill, add, read back, free
+    def request(r):
+        a_id, b_id, out_id = (fpga.malloc(4 * n_eles) for _ in range(3))
+        a = np.arange(n_eles, dtype=np.int32) + r
+        b = np.full(n_eles, r, dtype=np.int32)
+        fpga.write_buffer(a_id, a)
+        fpga.write_buffer(b_id, b)
+        fpga.copy_to_fpga(a_id)
+        fpga.copy_to_fpga(b_id)
+        ok = fpga.vector_add_async(a_id, b_id, out_id, n_eles).result()
+        fpga.copy_from_fpga(out_id)
+        ok = ok and np.array_equal(np.array(fpga.as_array(out_id)), a + b)
+        for mem_id in (a_id, b_id, out_id):
+            fpga.free_memory(mem_id)
+        return ok
+
+    try:
+        with ThreadPoolExecutor(max_workers=8) as pool:
+            results = list(pool.map(request, range(n_requests)))
+        passed = all(results) and fpga.get_memory_count() == 0
+        print(f"✔️ Concurrent test PASSED ({n_requests} requests, 8 threads)" if passed
+              else "❌ Concurrent test FAILED")
+    except Exception as e:
+        print(f"❌ Concurrent test failed with error: {e}")
+
 def main(test:int):
     print("=== Beethoven Python Binding Test (Integer Vector Addition) ===")
     print("This script tests the Python bindings for Beethoven's FPGA vector addition.")
@@ -200,6 +367,18 @@ def main(test:int):
     elif test == 3:
         print("Running full vector addition tests...")
         test_vector_addition_full()
+    elif test == 4:
+        print("Running zero-copy NumPy tests...")
+        test_numpy_zero_copy()
+    elif test == 5:
+        print("Running async submission tests...")
+        test_async_submission()
+    elif test == 6:
+        print("Running concurrent submission tests...")
+        test_concurrent_submission()
+    elif test == 7:
+        print("Running view ownership tests...")
+        test_view_outlives_free()
     
     
     print("\n=== Test Complete ===")
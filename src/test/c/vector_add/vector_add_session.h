@@ -0,0 +1,323 @@
+#ifndef BEETHOVEN_TEMPLATE_VECTOR_ADD_SESSION_H
+#define BEETHOVEN_TEMPLATE_VECTOR_ADD_SESSION_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../common/pool_allocator.h"
+
+using namespace beethoven;
+
+using vector_add_response = decltype(myVectorAdd::vector_add(0, remote_ptr(), remote_ptr(), remote_ptr(), 0));
+
+// Waits on accelerator responses off the Python thread. A core answers its
+// commands in order, so each core gets one FIFO and one waiter thread.
+class CompletionQueue {
+private:
+    struct pending {
+        vector_add_response resp;
+        std::promise<bool> done;
+    };
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<pending> queue;
+    bool stopping = false;
+    // commands pushed but not answered yet, read lock-free by the scheduler
+    std::atomic<int> outstanding{0};
+    std::thread waiter;
+
+    void run() {
+        while (true) {
+            std::optional<pending> next;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                cv.wait(guard, [this] { return stopping || !queue.empty(); });
+                // drain everything that was submitted before shutting down
+                if (queue.empty()) {
+                    return;
+                }
+                next.emplace(std::move(queue.front()));
+                queue.pop_front();
+            }
+            std::optional<bool> result;
+            std::exception_ptr error;
+            try {
+                result = next->resp.get();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // count the core as free before anyone waiting on the future wakes up
+            outstanding.fetch_sub(1, std::memory_order_relaxed);
+            if (result) {
+                next->done.set_value(*result);
+            } else {
+                next->done.set_exception(error);
+            }
+        }
+    }
+
+public:
+    CompletionQueue() : waiter([this] { run(); }) {}
+
+    ~CompletionQueue() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        cv.notify_one();
+        waiter.join();
+    }
+
+    int load() const {
+        return outstanding.load(std::memory_order_relaxed);
+    }
+
+    // reserve a slot before issuing, so concurrent schedulers see the core as busy
+    void add_pending() {
+        outstanding.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // the command counted by add_pending() was never issued
+    void drop_pending() {
+        outstanding.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // the response for a command counted by add_pending()
+    std::shared_future<bool> push(vector_add_response resp) {
+        std::promise<bool> done;
+        auto fut = done.get_future().share();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            queue.push_back(pending{std::move(resp), std::move(done)});
+        }
+        cv.notify_one();
+        return fut;
+    }
+};
+
+// A pooled segment that goes back to the pool when its last owner lets go:
+// the MemoryTable entry and every NumPy view of it hold a shared reference,
+// so free_memory() with views still alive only drops the ID, and the pool
+// can't hand the segment to another allocation while a view can reach it.
+class PooledBlock {
+private:
+    pool::pool_allocator &allocator;
+    remote_ptr mem;
+
+public:
+    PooledBlock(pool::pool_allocator &allocator, remote_ptr mem) : allocator(allocator), mem(mem) {}
+
+    PooledBlock(const PooledBlock &) = delete;
+    PooledBlock &operator=(const PooledBlock &) = delete;
+
+    ~PooledBlock() {
+        allocator.free(mem);
+    }
+
+    const remote_ptr &get() const {
+        return mem;
+    }
+};
+
+// Allocation-ID table that many threads can use at once. IDs come from an
+// atomic counter and entries are spread over shards by ID, each shard with
+// its own lock, so threads working on different allocations rarely meet.
+// Lookups return copies, so an entry freed by another thread can't dangle.
+class MemoryTable {
+public:
+    struct allocation {
+        std::shared_ptr<PooledBlock> block;
+        // requested size, pooled segments may be larger
+        size_t size;
+    };
+
+private:
+    static constexpr size_t n_shards = 16;
+    struct shard {
+        std::mutex lock;
+        std::unordered_map<size_t, allocation> entries;
+    };
+    std::array<shard, n_shards> shards;
+    std::atomic<size_t> next_id{0};
+
+    shard &shard_of(size_t id) {
+        return shards[id % n_shards];
+    }
+
+public:
+    size_t insert(const allocation &a) {
+        size_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+        auto &sh = shard_of(id);
+        std::lock_guard<std::mutex> guard(sh.lock);
+        sh.entries.emplace(id, a);
+        return id;
+    }
+
+    allocation find(size_t id) {
+        auto &sh = shard_of(id);
+        std::lock_guard<std::mutex> guard(sh.lock);
+        auto it = sh.entries.find(id);
+        if (it == sh.entries.end()) {
+            throw std::runtime_error("Invalid memory ID");
+        }
+        return it->second;
+    }
+
+    std::optional<allocation> erase(size_t id) {
+        auto &sh = shard_of(id);
+        std::lock_guard<std::mutex> guard(sh.lock);
+        auto it = sh.entries.find(id);
+        if (it == sh.entries.end()) {
+            return std::nullopt;
+        }
+        auto a = it->second;
+        sh.entries.erase(it);
+        return a;
+    }
+
+    size_t size() {
+        size_t n = 0;
+        for (auto &sh : shards) {
+            std::lock_guard<std::mutex> guard(sh.lock);
+            n += sh.entries.size();
+        }
+        return n;
+    }
+};
+
+// Everything behind the Python wrapper that doesn't touch the interpreter,
+// so session_test can drive it from C++ threads. Every method can be called
+// from many threads at once: allocations go through the sharded MemoryTable
+// and the locked pool allocator, and commands are issued under a per-core
+// lock, so threads submitting to different cores never wait for each other.
+// Copies of different allocations may run concurrently.
+class VectorAddSession {
+private:
+    fpga_handle_t handle;
+    // recycles freed segments so a long session doesn't pay for malloc on every request
+    pool::pool_allocator allocator{handle};
+    MemoryTable memory;
+    // declared after `handle` so the waiters are joined before it goes away
+    std::vector<std::unique_ptr<CompletionQueue>> completions;
+    // a core's commands must reach its CompletionQueue in issue order
+    std::unique_ptr<std::mutex[]> submit_locks{new std::mutex[VECTOR_ADD_N_CORES]};
+    std::atomic<unsigned> next_core{0};
+
+    // the core with the fewest outstanding commands, scanning from a rotating
+    // start so ties are spread round-robin
+    int pick_core() {
+        unsigned start = next_core.fetch_add(1, std::memory_order_relaxed);
+        int best = start % VECTOR_ADD_N_CORES;
+        for (int i = 1; i < VECTOR_ADD_N_CORES; ++i) {
+            int core = (start + i) % VECTOR_ADD_N_CORES;
+            if (completions[core]->load() < completions[best]->load()) {
+                best = core;
+            }
+        }
+        return best;
+    }
+
+public:
+    VectorAddSession() {
+        for (int i = 0; i < VECTOR_ADD_N_CORES; ++i) {
+            completions.emplace_back(new CompletionQueue());
+        }
+    }
+
+    // allocate a pooled segment of at least `size` bytes and return its ID
+    size_t malloc(size_t size) {
+        auto block = std::make_shared<PooledBlock>(allocator, allocator.malloc(size));
+        return memory.insert({std::move(block), size});
+    }
+
+    // a copy of the entry, which keeps its segment out of the pool while held
+    MemoryTable::allocation find(size_t mem_id) {
+        return memory.find(mem_id);
+    }
+
+    remote_ptr lookup(size_t mem_id) {
+        return memory.find(mem_id).block->get();
+    }
+
+    void write_int_array(size_t mem_id, const std::vector<int> &data) {
+        auto host_ptr = static_cast<int*>(lookup(mem_id).getHostAddr());
+        std::memcpy(host_ptr, data.data(), data.size() * sizeof(int));
+    }
+
+    std::vector<int> read_int_array(size_t mem_id, size_t num_elements) {
+        auto host_ptr = static_cast<int*>(lookup(mem_id).getHostAddr());
+        std::vector<int> result(num_elements);
+        std::memcpy(result.data(), host_ptr, num_elements * sizeof(int));
+        return result;
+    }
+
+    void copy_to_fpga(size_t mem_id) {
+        handle.copy_to_fpga(lookup(mem_id));
+    }
+
+    void copy_from_fpga(size_t mem_id) {
+        handle.copy_from_fpga(lookup(mem_id));
+    }
+
+    // Issue a vector addition and return a future for its status. core_id < 0
+    // picks the core with the fewest commands in flight.
+    std::shared_future<bool> submit(size_t vec_a_mem_id, size_t vec_b_mem_id, size_t vec_out_mem_id,
+                                    int n_eles, int core_id) {
+        auto vec_a = lookup(vec_a_mem_id), vec_b = lookup(vec_b_mem_id);
+        auto vec_out = lookup(vec_out_mem_id);
+        if (core_id >= VECTOR_ADD_N_CORES) {
+            throw std::runtime_error("Invalid core ID");
+        }
+        if (core_id < 0) {
+            core_id = pick_core();
+        }
+        auto &queue = *completions[core_id];
+        queue.add_pending();
+        std::lock_guard<std::mutex> guard(submit_locks[core_id]);
+        try {
+            auto resp_handle = myVectorAdd::vector_add(core_id, vec_a, vec_b, vec_out, n_eles);
+            return queue.push(std::move(resp_handle));
+        } catch (...) {
+            queue.drop_pending();
+            throw;
+        }
+    }
+
+    // the ID is gone at once, the segment returns to the pool when nothing
+    // else holds its entry
+    void free_memory(size_t mem_id) {
+        memory.erase(mem_id);
+    }
+
+    // pre-allocate `count` segments able to hold `size` bytes
+    void reserve_memory(size_t size, int count) {
+        allocator.reserve(size, count);
+    }
+
+    // give every cached (freed) segment back to the device allocator
+    void trim_memory() {
+        allocator.trim();
+    }
+
+    pool::stats get_memory_stats() {
+        return allocator.get_stats();
+    }
+
+    size_t get_memory_count() {
+        return memory.size();
+    }
+};
+
+#endif
@@ -1,15 +1,22 @@
 #include <iostream>
 #include <beethoven/fpga_handle.h>
 #include <beethoven_hardware.h>
+#include <vector>
+#include "../common/golden.h"
+#include "../common/perf_counters.h"
+#include "../common/pool_allocator.h"
+#include "../common/trace.h"
 
 using namespace beethoven;
 int main() {
+  trace::init_from_env();
   fpga_handle_t handle;
+  pool::pool_allocator pool(handle);
   int size_of_int = 4;
   int n_eles = 32;
-  auto vec_a = handle.malloc(size_of_int * n_eles);
-  auto vec_b = handle.malloc(size_of_int * n_eles);
-  auto vec_out = handle.malloc(size_of_int * n_eles);
+  auto vec_a = pool.malloc(size_of_int * n_eles);
+  auto vec_b = pool.malloc(size_of_int * n_eles);
+  auto vec_out = pool.malloc(size_of_int * n_eles);
 
   auto vec_a_host = (int*)vec_a.getHostAddr();
   auto vec_b_host = (int*)vec_b.getHostAddr();
@@ -19,18 +26,62 @@ int main() {
   }
   handle.copy_to_fpga(vec_a);
   handle.copy_to_fpga(vec_b);
+  myVectorAdd::reset_counters(0).get();
   myVectorAdd::vector_add(0,
                           vec_a,
                           vec_b,
                           vec_out,
                           n_eles).get();
+  perf::read({"vec_a", "vec_b"}, [](int id) {
+    return myVectorAdd::read_counters(0, id).get().value;
+  }).print(stdout, "vector_add core 0");
 
   handle.copy_from_fpga(vec_out);
   
   auto output = (int*)vec_out.getHostAddr();
+  std::vector<int> expected(n_eles);
+  golden::vector_add(vec_a_host, vec_b_host, expected.data(), n_eles);
+  bool success = true;
   for (int i = 0; i < n_eles; ++i) {
-    if (output[i] != (i+1) + (i*2)) {
-      printf("Err on %d: %d =/= %d\n", i, output[i], (i+1)+(i*2));
+    if (output[i] != expected[i]) {
+      printf("Err on %d: %d =/= %d\n", i, output[i], expected[i]);
+      success = false;
     }
   }
+
+  // a length that isn't a multiple of the lane count: whole beats plus a
+  // tail, and nothing past the end of the output may be written
+  int ragged = 2 * VECTOR_ADD_LANES + 3, guard = VECTOR_ADD_LANES;
+  auto rag_a = pool.malloc(size_of_int * ragged);
+  auto rag_b = pool.malloc(size_of_int * ragged);
+  auto rag_out = pool.malloc(size_of_int * (ragged + guard));
+  auto rag_a_host = (int*)rag_a.getHostAddr();
+  auto rag_b_host = (int*)rag_b.getHostAddr();
+  auto rag_out_host = (int*)rag_out.getHostAddr();
+  for (int i = 0; i < ragged; ++i) {
+    rag_a_host[i] = 3 * i - 7;
+    rag_b_host[i] = 1000 + i;
+  }
+  for (int i = 0; i < ragged + guard; ++i) {
+    rag_out_host[i] = -1;
+  }
+  handle.copy_to_fpga(rag_a);
+  handle.copy_to_fpga(rag_b);
+  handle.copy_to_fpga(rag_out);
+  myVectorAdd::vector_add(0, rag_a, rag_b, rag_out, ragged).get();
+  handle.copy_from_fpga(rag_out);
+  std::vector<int> rag_expected(ragged);
+  golden::vector_add(rag_a_host, rag_b_host, rag_expected.data(), ragged);
+  for (int i = 0; i < ragged + guard; ++i) {
+    int want = i < ragged ? rag_expected[i] : -1;
+    if (rag_out_host[i] != want) {
+      printf("Ragged err on %d: %d =/= %d\n", i, rag_out_host[i], want);
+      success = false;
+    }
+  }
+
+  if (success) {
+    printf("Success!\n");
+  }
+  return success ? 0 : 1;
 }
@@ -0,0 +1,92 @@
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../common/golden.h"
+#include "../common/perf_counters.h"
+#include "../common/pool_allocator.h"
+#include "../common/trace.h"
+#include "reduce.h"
+
+using namespace beethoven;
+
+// Every reduction over lengths around the beat size, split over 1..N cores,
+// checked against the golden model. The elements cover the full 32-bit range
+// so the 64-bit sums wrap.
+
+int main() {
+    trace::init_from_env();
+    fpga_handle_t handle;
+    // each length's buffers are recycled for later lengths in the same size class
+    pool::pool_allocator pool(handle);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int32_t> any(INT32_MIN, INT32_MAX);
+
+    const char *names[] = {"dot", "sum", "min", "max", "sq_norm"};
+    int lanes = VECTOR_DOT_LANES;
+    std::vector<uint64_t> lengths = {1, 3, (uint64_t)lanes - 1, (uint64_t)lanes,
+                                     (uint64_t)lanes + 1, 3ull * lanes + 7, 1000, 100003};
+    int errors = 0;
+    for (int c = 0; c < VECTOR_DOT_N_CORES; ++c) {
+        myVectorDot::reset_counters(c).get();
+    }
+    for (auto n : lengths) {
+        auto vec_a = pool.malloc(sizeof(int32_t) * n);
+        auto vec_b = pool.malloc(sizeof(int32_t) * n);
+        auto a_host = (int32_t *)vec_a.getHostAddr();
+        auto b_host = (int32_t *)vec_b.getHostAddr();
+        for (uint64_t i = 0; i < n; ++i) {
+            a_host[i] = any(rng);
+            b_host[i] = any(rng);
+        }
+        handle.copy_to_fpga(vec_a);
+        handle.copy_to_fpga(vec_b);
+        for (int op = golden::dot; op <= golden::sq_norm; ++op) {
+            auto want = golden::reduce(op, a_host, b_host, n);
+            for (int cores = 1; cores <= VECTOR_DOT_N_CORES; ++cores) {
+                auto got = vector_dot::reduce((vector_dot::op)op, vec_a, vec_b, n, cores);
+                if (got != want) {
+                    printf("Err on %s, n = %llu, %d cores: %lld =/= %lld\n", names[op],
+                           (unsigned long long)n, cores, (long long)got, (long long)want);
+                    ++errors;
+                }
+            }
+        }
+        pool.free(vec_a);
+        pool.free(vec_b);
+    }
+
+    // the typed helpers on a small known vector
+    int n = 2 * lanes + 1;
+    auto vec = pool.malloc(sizeof(int32_t) * n);
+    auto host = (int32_t *)vec.getHostAddr();
+    for (int i = 0; i < n; ++i) {
+        host[i] = i - lanes;
+    }
+    handle.copy_to_fpga(vec);
+    double norm = 0;
+    for (int i = 0; i < n; ++i) {
+        norm += double(host[i]) * host[i];
+    }
+    if (vector_dot::sum(vec, n) != 0 || vector_dot::min(vec, n) != -lanes ||
+        vector_dot::max(vec, n) != lanes || vector_dot::dot(vec, vec, n) != (int64_t)norm ||
+        std::abs(vector_dot::l2_norm(vec, n) - std::sqrt(norm)) > 1e-9) {
+        printf("Err on the typed helpers\n");
+        ++errors;
+    }
+    pool.free(vec);
+
+    for (int c = 0; c < VECTOR_DOT_N_CORES; ++c) {
+        char label[32];
+        snprintf(label, sizeof(label), "vector_dot core %d", c);
+        perf::read({"vec_a", "vec_b"}, [&](int id) {
+            return myVectorDot::read_counters(c, id).get().value;
+        }).print(stdout, label);
+    }
+    printf(errors ? "FAILED (%d errors)\n" : "PASSED\n", errors);
+    pool.trim();
+    handle.shutdown();
+    return errors != 0;
+}
@@ -0,0 +1,45 @@
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <cstdio>
+#include <vector>
+#include "../common/golden.h"
+
+using namespace beethoven;
+
+// Starting point for the vector_dot exercise: one reduction of each kind on
+// core 0, checked against the golden model.
+//
+// TODO: one core folds VECTOR_DOT_LANES elements per cycle. Split a long
+// vector over all VECTOR_DOT_N_CORES cores and combine their partial results
+// (see main-solution.cc and reduce.h once you're done).
+
+int main() {
+    fpga_handle_t handle;
+    int n_eles = 4 * VECTOR_DOT_LANES + 5;
+    auto vec_a = handle.malloc(sizeof(int32_t) * n_eles);
+    auto vec_b = handle.malloc(sizeof(int32_t) * n_eles);
+    auto a_host = (int32_t *)vec_a.getHostAddr();
+    auto b_host = (int32_t *)vec_b.getHostAddr();
+    for (int i = 0; i < n_eles; ++i) {
+        a_host[i] = 7 * i - 100;
+        b_host[i] = 3 - i;
+    }
+    handle.copy_to_fpga(vec_a);
+    handle.copy_to_fpga(vec_b);
+
+    const char *names[] = {"dot", "sum", "min", "max", "sq_norm"};
+    int errors = 0;
+    for (int op = golden::dot; op <= golden::sq_norm; ++op) {
+        auto got = (int64_t)myVectorDot::reduce(0, op, vec_a, vec_b, n_eles).get().value;
+        auto want = golden::reduce(op, a_host, b_host, n_eles);
+        printf("%s: %lld\n", names[op], (long long)got);
+        if (got != want) {
+            printf("Err on %s: %lld =/= %lld\n", names[op], (long long)got, (long long)want);
+            ++errors;
+        }
+    }
+    handle.free(vec_a);
+    handle.free(vec_b);
+    handle.shutdown();
+    return errors != 0;
+}
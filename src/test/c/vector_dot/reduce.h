@@ -0,0 +1,99 @@
+#ifndef VECTOR_DOT_REDUCE_H
+#define VECTOR_DOT_REDUCE_H
+
+#include <beethoven/fpga_handle.h>
+#include <beethoven_hardware.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "../common/golden.h"
+#include "../common/trace.h"
+
+// Multi-core reductions over device-resident vectors of signed 32-bit
+// elements (myVectorDot::reduce).
+//
+// The vector is cut into one contiguous chunk per core, each a whole number
+// of VECTOR_DOT_LANES-element beats so only the last chunk has a tail, and
+// no chunk longer than one command's 32-bit vector_length. Every core
+// answers with its partial in the response, and the partials are combined
+// here in core order with the same arithmetic the core uses, so the result
+// doesn't depend on how many cores took part.
+
+namespace vector_dot {
+using namespace beethoven;
+using op = golden::reduce_op;
+
+// the longest run one command can fold, a whole number of beats
+constexpr uint64_t max_command_elems = UINT32_MAX / VECTOR_DOT_LANES * VECTOR_DOT_LANES;
+
+// reduce a[0..n) (and b[0..n) for dot) on up to n_cores cores; both vectors
+// must already be on the device. b is ignored for every op but dot.
+inline int64_t reduce(op o, const remote_ptr &a, const remote_ptr &b, uint64_t n,
+                      int n_cores = VECTOR_DOT_N_CORES) {
+    if (o < op::dot || o > op::sq_norm) {
+        throw std::runtime_error("Unknown vector_dot reduction");
+    }
+    if (a.getLen() < n * sizeof(int32_t) || (o == op::dot && b.getLen() < n * sizeof(int32_t))) {
+        throw std::runtime_error("vector_dot operand shorter than the reduction");
+    }
+    n_cores = std::max(1, std::min(n_cores, VECTOR_DOT_N_CORES));
+    uint64_t beats = (n + VECTOR_DOT_LANES - 1) / VECTOR_DOT_LANES;
+    uint64_t chunk = (beats + n_cores - 1) / n_cores * VECTOR_DOT_LANES;
+    chunk = std::max<uint64_t>(VECTOR_DOT_LANES, std::min(chunk, max_command_elems));
+
+    using response = decltype(myVectorDot::reduce(0, 0, remote_ptr(), remote_ptr(), 0));
+    std::vector<trace::traced<response>> running;
+    int core = 0;
+    for (uint64_t start = 0; start < n; start += chunk) {
+        uint32_t len = (uint32_t)std::min(chunk, n - start);
+        size_t offset = start * sizeof(int32_t);
+        size_t bytes = (o == op::dot ? 2 : 1) * sizeof(int32_t) * len;
+        // more chunks than cores only past 4G elements per core: queue them round-robin
+        running.push_back(trace::issue("reduce", core, bytes, [&] {
+            return myVectorDot::reduce(core, (uint8_t)o, a + offset, o == op::dot ? b + offset : a,
+                                       len);
+        }));
+        core = (core + 1) % n_cores;
+    }
+
+    int64_t result = golden::reduce_identity(o);
+    for (auto &resp : running) {
+        result = golden::reduce_combine(o, result, (int64_t)resp.get().value);
+    }
+    return result;
+}
+
+inline int64_t dot(const remote_ptr &a, const remote_ptr &b, uint64_t n,
+                   int n_cores = VECTOR_DOT_N_CORES) {
+    return reduce(op::dot, a, b, n, n_cores);
+}
+
+inline int64_t sum(const remote_ptr &a, uint64_t n, int n_cores = VECTOR_DOT_N_CORES) {
+    return reduce(op::sum, a, a, n, n_cores);
+}
+
+// min / max have no value for an empty vector
+inline int32_t min(const remote_ptr &a, uint64_t n, int n_cores = VECTOR_DOT_N_CORES) {
+    if (n == 0) {
+        throw std::runtime_error("vector_dot::min of an empty vector");
+    }
+    return (int32_t)reduce(op::min, a, a, n, n_cores);
+}
+
+inline int32_t max(const remote_ptr &a, uint64_t n, int n_cores = VECTOR_DOT_N_CORES) {
+    if (n == 0) {
+        throw std::runtime_error("vector_dot::max of an empty vector");
+    }
+    return (int32_t)reduce(op::max, a, a, n, n_cores);
+}
+
+// the squares are summed exactly (mod 2^64) on the device, the root is taken here
+inline double l2_norm(const remote_ptr &a, uint64_t n, int n_cores = VECTOR_DOT_N_CORES) {
+    return std::sqrt((double)(uint64_t)reduce(op::sq_norm, a, a, n, n_cores));
+}
+
+} // namespace vector_dot
+
+#endif